@@ -57,6 +57,7 @@ extern P3_VmStats P3_vmStats;
 #define P3_OUT_OF_PAGES             -39
 #define P3_INVALID_FRAME            -40
 #define P3_INVALID_PAGE             -41
+#define P3_OUT_OF_FRAMES            -42
 
 #ifndef CHECKRETURN
 #define CHECKRETURN __attribute__((warn_unused_result))
@@ -37,21 +37,188 @@ USLOSS_PTE *P3PageTableAllocateEmpty(int numPages) CHECKRETURN;
 
 // Phase 3c
 
+/*
+ * Frame descriptors. The frame table is owned by the frame module (phase 3c) and shared with
+ * the swap module (phase 3d); P3_frames[f] describes frame f. It answers "which page is in
+ * this frame" directly, so nobody has to search page tables for a frame.
+ *
+ * Phase 3d relies on these and the other phase 3c internals below, so it only links against
+ * the phase3c in this tree, never the reference phase3c library (see phase3d/Makefile).
+ */
+
+#define P3_FRAME_FREE   0   // in the pool of free frames
+#define P3_FRAME_BUSY   1   // allocated, but not mapped by its owner (being filled or evicted)
+#define P3_FRAME_INUSE  2   // holds page "page" of process "pid"; candidate for replacement
+
+#define P3_FRAME_ZEROED 0x1 // flag: the frame is known to contain all zeros
+
+typedef struct P3Frame {
+    int     state;      // P3_FRAME_*
+    PID     pid;        // process whose page is in the frame, -1 if none
+    int     page;       // page of pid that maps the frame
+    PID     mapPid;     // process that mapped the frame with P3FrameMap, -1 if none
+    int     mapPage;    // page through which mapPid mapped the frame
+    int     flags;      // bookkeeping bits for the frame's current use
+} P3Frame;
+
+extern P3Frame  *P3_frames;
+
 int         P3FrameInit(int pages, int frames) CHECKRETURN;
 int         P3FrameShutdown(void) CHECKRETURN;
 int         P3FrameFreeAll(PID pid) CHECKRETURN;
 int         P3FrameMap(int frame, void **addr) CHECKRETURN;
 int         P3FrameUnmap(int frame) CHECKRETURN;
+int         P3FrameAlloc(int *frame) CHECKRETURN;
+int         P3FrameAllocZeroed(int *frame) CHECKRETURN;
+int         P3FrameRelease(int frame) CHECKRETURN;
+int         P3FrameClaim(int frame, PID pid, int *page) CHECKRETURN;
+int         P3FrameUnclaim(int frame, PID pid, int page) CHECKRETURN;
 
 int         P3PagerInit(int pages, int frames, int pagers) CHECKRETURN;
 int         P3PagerShutdown(void)  CHECKRETURN;
 
+// When a process faults on consecutive pages the pager reads up to P3_readAhead of the pages
+// that follow from swap along with the faulting page (0 turns read-ahead off).
+extern int  P3_readAhead;
+
+// Number of faults that may wait for a pager at once; further faulting processes are held
+// back until a pager takes a fault off the queue. Defaults to P1_MAXPROC (no limit).
+extern int  P3_maxQueuedFaults;
+
+// Pending faults are served in order of the faulting process's priority; a fault is passed by at
+// most P3_faultAging later faults per priority level it is below them (0 makes the queue FIFO).
+extern int  P3_faultAging;
+
+// The pager pool grows from the number passed to P3PagerInit up to P3_maxPagers (at most
+// 4*P3_MAX_PAGERS) when faults have waited P3_pagerGrowDelay microseconds or a batch's worth
+// is queued, and shrinks back as pagers stay idle for P3_pagerIdleTimeout microseconds.
+extern int  P3_maxPagers;
+extern int  P3_pagerGrowDelay;
+extern int  P3_pagerIdleTimeout;
+
+// A first-touch fault also zero-fills the other never-touched pages of the aligned
+// P3_faultAround-page window around it while free frames are plentiful (1 turns it off).
+extern int  P3_faultAround;
+
+// page operations (pageops.c)
+
+void        P3PageZero(void *page);
+void        P3PageCopy(void *dst, const void *src);
+
 // Phase 3d
 
 int         P3SwapInit(int pages, int frames) CHECKRETURN;
 int         P3SwapShutdown(void) CHECKRETURN;
 int         P3SwapFreeAll(PID pid) CHECKRETURN;
 int         P3SwapOut(int *frame) CHECKRETURN;
+int         P3SwapOutProcess(PID pid, int *evicted) CHECKRETURN;
 int         P3SwapIn(PID pid, int page, int frame) CHECKRETURN;
+int         P3SwapInRun(PID pid, int page, int *frames, int count, int *read) CHECKRETURN;
+int         P3SwapProbe(PID pid, int page, int *track) CHECKRETURN;
+
+// P3SwapOut writes up to P3_swapOutCluster dirty pages to contiguous swap slots with a single
+// disk request (1 turns clustering off). Set it before P3_VmInit; it is capped at
+// P3_MAX_SWAP_CLUSTER and at 1/8 of the frames.
+#define P3_MAX_SWAP_CLUSTER 16
+extern int  P3_swapOutCluster;
+
+/*
+ * Page replacement policies (phase3d/policy.c). P3SwapInit sets up the policy chosen by
+ * P3_replacementPolicy (set it before P3_VmInit) and P3SwapOut asks it for victims. The
+ * pagers call mapped when a frame starts holding a page and unmapped when it stops; either
+ * may be called for a frame that is already in that state. referenced is called whenever
+ * a frame's reference bit is found set and cleared.
+ */
+
+#define P3_POLICY_CLOCK     0   // clock
+#define P3_POLICY_FIFO      1   // FIFO with second chance
+#define P3_POLICY_CLOCK2    2   // two-handed clock
+#define P3_POLICY_LRU       3   // LRU of the observed references (reference policy, slow)
+#define P3_POLICY_WSCLOCK   4   // WSClock, see P3_workingSetWindow
+#define P3_POLICY_AGING     5   // reference-bit history kept by a daemon, see P3_agingInterval
+
+typedef struct P3Policy {
+    char    *name;
+    void    (*init)(int frames);
+    void    (*shutdown)(void);
+    int     (*select)(void);            // a frame in use to replace, -1 if none
+    void    (*mapped)(int frame);
+    void    (*unmapped)(int frame);
+    void    (*referenced)(int frame);
+} P3Policy;
+
+extern int      P3_replacementPolicy;
+
+// WSClock treats a page that hasn't been seen referenced for P3_workingSetWindow microseconds as
+// out of its process's working set.
+extern int      P3_workingSetWindow;
+
+// The aging policy's daemon samples the reference bits every P3_agingInterval seconds.
+extern int      P3_agingInterval;
+extern P3Policy *P3_policy;             // policy in use, NULL if none
+
+int         P3PolicyInit(int frames) CHECKRETURN;
+int         P3PolicyShutdown(void) CHECKRETURN;
+
+/*
+ * Page-fault-frequency control (phase3d/pff.c). Each process gets a frame target that grows
+ * while it takes more than P3_pffHigh major faults (faults that go to a pager) per
+ * P3_pffWindow microseconds and shrinks while it takes fewer than P3_pffLow. P3SwapOut
+ * prefers to evict pages of processes above their target, then of processes that rarely
+ * fault. Setting P3_pff to FALSE turns the preference off.
+ */
+
+extern int  P3_pff;
+extern int  P3_pffWindow;
+extern int  P3_pffHigh;
+extern int  P3_pffLow;
+
+int         P3PffInit(int frames) CHECKRETURN;
+int         P3PffShutdown(void) CHECKRETURN;
+void        P3PffFault(PID pid);
+void        P3PffExit(PID pid);
+int         P3PffUpdate(void);
+int         P3PffRank(PID pid);
+
+/*
+ * Load control (phase3d/load.c). Every P3_loadInterval seconds a daemon checks for thrashing:
+ * faults on at least P3_thrashTurnover percent of the frames in the interval with at least
+ * P3_thrashQueue faults waiting for a pager. It then suspends the lowest-priority process
+ * until the fault rate has halved. A suspended process is paged out at once and parked on its
+ * next fault until it is resumed. Load control is off by default: set P3_loadControl to TRUE
+ * before P3_VmInit to start the daemon. Setting it back to FALSE resumes everyone. If it is
+ * FALSE when P3_VmInit runs, no daemon is started and faults aren't counted.
+ */
+
+extern int  P3_loadControl;
+extern int  P3_loadInterval;
+extern int  P3_thrashTurnover;
+extern int  P3_thrashQueue;
+
+typedef struct P3LoadStats {
+    int suspends;   // # of times a process was suspended
+    int resumes;    // # of times a suspended process was resumed
+    int pagedOut;   // # of pages evicted from processes as they were suspended
+} P3LoadStats;
+
+extern P3LoadStats P3_loadStats;    // cleared by P3LoadInit, updated under loadLock
+
+int         P3LoadInit(int frames) CHECKRETURN;
+int         P3LoadShutdown(void) CHECKRETURN;
+void        P3LoadControl(PID pid, int queued);
+int         P3LoadSuspended(PID pid);
+void        P3LoadExit(PID pid);
+
+/*
+ * Tickers (phase3d/ticker.c) wake up a daemon every *interval seconds. The daemon blocks in
+ * P3TickerWait, which returns FALSE once P3TickerStop has been called, so stopping a daemon
+ * doesn't have to wait out its sleep. The ticker process frees itself the next time it wakes.
+ */
+
+typedef struct P3Ticker P3Ticker;
+
+P3Ticker    *P3TickerStart(char *name, int *interval, int priority);
+int         P3TickerWait(P3Ticker *ticker);
+void        P3TickerStop(P3Ticker *ticker);
 
 #endif
@@ -0,0 +1,91 @@
+/*
+ * pageops.c
+ *
+ *  Page-sized memory operations used on the paging paths of phase3c and phase3d.
+ *  Pages are handled 16 bytes at a time with SSE2 when the compiler targets it,
+ *  otherwise a machine word at a time. Define P3_NO_SIMD to force the word-wide
+ *  versions. Any tail that isn't a whole number of chunks is handled a byte at a time.
+ */
+
+#include <phase1.h>
+#include <usloss.h>
+
+#include "phase3Int.h"
+
+#if defined(__SSE2__) && !defined(P3_NO_SIMD)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+// a word that is allowed to alias the page's bytes
+typedef unsigned long __attribute__((__may_alias__)) Word;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PageZero --
+ *
+ *  Fills a page with zeros.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3PageZero(void *page)
+{
+    int size = USLOSS_MmuPageSize();
+    char *p = (char *) page;
+    int i = 0;
+#ifdef USE_SSE2
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 64 <= size; i += 64) {
+        _mm_storeu_si128((__m128i *) (p + i), zero);
+        _mm_storeu_si128((__m128i *) (p + i + 16), zero);
+        _mm_storeu_si128((__m128i *) (p + i + 32), zero);
+        _mm_storeu_si128((__m128i *) (p + i + 48), zero);
+    }
+#else
+    for (; i + (int) sizeof(Word) <= size; i += sizeof(Word)) {
+        *(Word *) (p + i) = 0;
+    }
+#endif
+    for (; i < size; i++) {
+        p[i] = 0;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PageCopy --
+ *
+ *  Copies a page from src to dst. The pages must not overlap.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3PageCopy(void *dst, const void *src)
+{
+    int size = USLOSS_MmuPageSize();
+    char *d = (char *) dst;
+    const char *s = (const char *) src;
+    int i = 0;
+#ifdef USE_SSE2
+    for (; i + 64 <= size; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (s + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (s + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (s + i + 32));
+        __m128i e = _mm_loadu_si128((const __m128i *) (s + i + 48));
+        _mm_storeu_si128((__m128i *) (d + i), a);
+        _mm_storeu_si128((__m128i *) (d + i + 16), b);
+        _mm_storeu_si128((__m128i *) (d + i + 32), c);
+        _mm_storeu_si128((__m128i *) (d + i + 48), e);
+    }
+#else
+    for (; i + (int) sizeof(Word) <= size; i += sizeof(Word)) {
+        *(Word *) (d + i) = *(const Word *) (s + i);
+    }
+#endif
+    for (; i < size; i++) {
+        d[i] = s[i];
+    }
+}
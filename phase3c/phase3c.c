@@ -20,6 +20,8 @@ int debugging3 = 0;
 #endif
 
 static int Pager(void*);
+static int PageoutDaemon(void*);
+static int ZeroDaemon(void*);
 void debug3(char *fmt, ...)
 {
     va_list ap;
@@ -42,25 +44,59 @@ void checkIfIsKernel(){
 }
 
 // helper functions for semaphores, makes code cleaner
-void P(int sid) {
+static void P(int sid) {
 	assert(P1_P(sid) == P1_SUCCESS);
 }
 
-void V(int sid) {
+static void V(int sid) {
 	assert(P1_V(sid) == P1_SUCCESS);
 }
 
 int frameInitialized = FALSE;
 int pageInitialized = FALSE;
-int numFrames;
-int numPages;
+static int numFrames;
+static int numPages;
 
-typedef struct f {
-	int used;
-	USLOSS_PTE *page;
-} Frame;
+P3Frame *P3_frames;
 
-Frame *frameTable;
+// Replacement policy told about frames being mapped and released; set by P3PolicyInit.
+P3Policy *P3_policy = NULL;
+
+// Pool of free frames. It is kept as two stacks of frame numbers so that
+// allocating and releasing a frame are both O(1): frames whose contents are
+// unknown, and frames that the zeroing daemon has already cleared.
+static int *freeList;
+static int freeCount;
+static int *zeroList;
+static int zeroCount;
+static int frameMutex;
+
+// The zeroing daemon runs at the lowest priority and moves frames from
+// freeList to zeroList, so most first-touch faults get a frame that
+// is already zeroed.
+#define ZERO_PRIORITY   5
+
+static int zeroWake;
+static int zeroIdle;
+static int zeroDone;
+
+// Pagers that find neither a free frame nor a page to replace wait on frameAvailable until a
+// frame is released or becomes replaceable.
+static int frameAvailable;
+static int frameWaiters;
+
+// The page-out daemon is woken when the number of free frames drops below lowWater and evicts
+// pages until highWater frames are free, so faults rarely have to evict a page themselves.
+// Machines with fewer than 16 frames have lowWater == 0 and no daemon.
+#define PAGEOUT_PRIORITY    (P3_PAGER_PRIORITY + 1)
+
+static int lowWater;
+static int highWater;
+static int pageoutWake;
+static int pageoutAwake;
+static int pageoutDone;
+
+static void FrameAvailable(void);
 
 /*
  *----------------------------------------------------------------------
@@ -84,11 +120,28 @@ P3FrameInit(int pages, int frames)
     // initialize the frame data structures, e.g. the pool of free frames
 	numFrames = frames;
 	numPages = pages;
-	frameTable = (Frame*) malloc(numFrames*sizeof(Frame));
+	P3_frames = (P3Frame*) malloc(numFrames*sizeof(P3Frame));
+	freeList = (int*) malloc(numFrames*sizeof(int));
+	zeroList = (int*) malloc(numFrames*sizeof(int));
 	for (int i = 0; i < numFrames; i++) {
-		frameTable[i].used = FALSE;
-		frameTable[i].page = NULL;
+		P3_frames[i].state = P3_FRAME_FREE;
+		P3_frames[i].pid = -1;
+		P3_frames[i].page = -1;
+		P3_frames[i].mapPid = -1;
+		P3_frames[i].mapPage = -1;
+		P3_frames[i].flags = 0;
+		// push in reverse so that low-numbered frames are handed out first
+		freeList[i] = numFrames - 1 - i;
 	}
+	freeCount = numFrames;
+	zeroCount = 0;
+	result = P1_SemCreate("frameMutex", 1, &frameMutex);
+	assert(result == P1_SUCCESS);
+	result = P1_SemCreate("frameAvailable", 0, &frameAvailable);
+	assert(result == P1_SUCCESS);
+	frameWaiters = 0;
+	lowWater = numFrames / 16;
+	highWater = numFrames / 8;
     // set P3_vmStats.freeFrames
 	P3_vmStats.freeFrames = frames;
 	
@@ -116,7 +169,13 @@ P3FrameShutdown(void)
     int result = P1_SUCCESS;
 
     // clean things up
-	free(frameTable);
+	free(P3_frames);
+	free(freeList);
+	free(zeroList);
+	result = P1_SemFree(frameMutex);
+	assert(result == P1_SUCCESS);
+	result = P1_SemFree(frameAvailable);
+	assert(result == P1_SUCCESS);
     return result;
 }
 
@@ -149,13 +208,210 @@ P3FrameFreeAll(int pid)
 		for (int i = 0; i < numPages; i++) {
 			if (table[i].incore) {
 				table[i].incore = 0;
-				frameTable[table[i].frame].used = FALSE;
+				result = P3FrameRelease(table[i].frame);
+				assert(result == P1_SUCCESS);
 			}
 		}
 	}
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameAlloc --
+ *
+ *  Removes a frame from the pool of free frames. Frames that haven't been
+ *  zeroed are handed out first, keeping the zeroed ones for first-touch
+ *  faults. P3_FRAME_ZEROED is set in the frame's flags if it is zeroed.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P3_OUT_OF_FRAMES:      there are no free frames
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameAlloc(int *frame)
+{
+	checkIfIsKernel();
+	if (!frameInitialized) return P3_NOT_INITIALIZED;
+
+	int result = P1_SUCCESS;
+	P(frameMutex);
+	if (freeCount > 0) {
+		*frame = freeList[--freeCount];
+	} else if (zeroCount > 0) {
+		*frame = zeroList[--zeroCount];
+	} else {
+		result = P3_OUT_OF_FRAMES;
+	}
+	if (result == P1_SUCCESS) {
+		P3_frames[*frame].state = P3_FRAME_BUSY;
+		P3_vmStats.freeFrames--;
+	}
+	if (P3_vmStats.freeFrames < lowWater && pageInitialized && !pageoutAwake) {
+		pageoutAwake = TRUE;
+		V(pageoutWake);
+	}
+	V(frameMutex);
+	return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameAllocZeroed --
+ *
+ *  Removes a frame that is known to be zeroed from the pool of free frames.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P3_OUT_OF_FRAMES:      there are no zeroed free frames
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameAllocZeroed(int *frame)
+{
+	checkIfIsKernel();
+	if (!frameInitialized) return P3_NOT_INITIALIZED;
+
+	int result = P1_SUCCESS;
+	P(frameMutex);
+	if (zeroCount == 0) {
+		result = P3_OUT_OF_FRAMES;
+	} else {
+		*frame = zeroList[--zeroCount];
+		P3_frames[*frame].state = P3_FRAME_BUSY;
+		P3_vmStats.freeFrames--;
+	}
+	if (P3_vmStats.freeFrames < lowWater && pageInitialized && !pageoutAwake) {
+		pageoutAwake = TRUE;
+		V(pageoutWake);
+	}
+	V(frameMutex);
+	return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameRelease --
+ *
+ *  Returns a frame to the pool of free frames.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P3_INVALID_FRAME:      the frame number is invalid or the frame is already free
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameRelease(int frame)
+{
+	checkIfIsKernel();
+	if (!frameInitialized) return P3_NOT_INITIALIZED;
+	if (frame < 0 || frame >= numFrames) return P3_INVALID_FRAME;
+
+	if (P3_policy != NULL) P3_policy->unmapped(frame);
+	int result = P1_SUCCESS;
+	P(frameMutex);
+	if (P3_frames[frame].state == P3_FRAME_FREE) {
+		result = P3_INVALID_FRAME;
+	} else {
+		P3_frames[frame].state = P3_FRAME_FREE;
+		P3_frames[frame].pid = -1;
+		P3_frames[frame].page = -1;
+		P3_frames[frame].flags = 0;
+		freeList[freeCount++] = frame;
+		P3_vmStats.freeFrames++;
+		FrameAvailable();
+		if (zeroIdle) {
+			zeroIdle = FALSE;
+			V(zeroWake);
+		}
+	}
+	V(frameMutex);
+	return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameClaim --
+ *
+ *  Marks an in-use frame busy so that it can't be chosen by the clock or
+ *  claimed by anyone else. The claimer owns the frame until it releases it
+ *  or puts it back in use. The page that is in the frame is returned in
+ *  *page if page isn't NULL; the PTE that maps it is left alone.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P3_INVALID_FRAME:      the frame number is invalid
+ *   P3_FRAME_NOT_MAPPED:   the frame doesn't hold a page of pid
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameClaim(int frame, PID pid, int *page)
+{
+	checkIfIsKernel();
+	if (!frameInitialized) return P3_NOT_INITIALIZED;
+	if (frame < 0 || frame >= numFrames) return P3_INVALID_FRAME;
+
+	int result = P1_SUCCESS;
+	P(frameMutex);
+	if (P3_frames[frame].state != P3_FRAME_INUSE || P3_frames[frame].pid != pid) {
+		result = P3_FRAME_NOT_MAPPED;
+	} else {
+		P3_frames[frame].state = P3_FRAME_BUSY;
+		if (page != NULL) *page = P3_frames[frame].page;
+	}
+	V(frameMutex);
+	return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameUnclaim --
+ *
+ *  Puts a frame claimed with P3FrameClaim back in use, holding the given page of pid, and
+ *  wakes up a pager waiting for a frame to become replaceable.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P3_INVALID_FRAME:      the frame number is invalid or the frame isn't claimed
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameUnclaim(int frame, PID pid, int page)
+{
+	checkIfIsKernel();
+	if (!frameInitialized) return P3_NOT_INITIALIZED;
+	if (frame < 0 || frame >= numFrames) return P3_INVALID_FRAME;
+
+	int result = P1_SUCCESS;
+	P(frameMutex);
+	if (P3_frames[frame].state != P3_FRAME_BUSY) {
+		result = P3_INVALID_FRAME;
+	} else {
+		P3_frames[frame].state = P3_FRAME_INUSE;
+		P3_frames[frame].pid = pid;
+		P3_frames[frame].page = page;
+		FrameAvailable();
+	}
+	V(frameMutex);
+	return result;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -197,8 +453,8 @@ P3FrameMap(int frame, void **ptr)
 	table[i].read = 1;
 	table[i].write = 1;
 	table[i].frame = frame;
-	frameTable[frame].used = TRUE;
-	frameTable[frame].page = table + i;
+	P3_frames[frame].mapPid = P1_GetPid();
+	P3_frames[frame].mapPage = i;
 	int np;
 	*ptr = USLOSS_MmuRegion(&np) + i*USLOSS_MmuPageSize();
     // update the page table in the MMU (USLOSS_MmuSetPageTable)
@@ -228,7 +484,6 @@ P3FrameUnmap(int frame)
 
 	if (!frameInitialized) return P3_NOT_INITIALIZED;
 	if (frame < 0 || frame >= numFrames) return P3_INVALID_FRAME;
-	if (!frameTable[frame].used) return P3_FRAME_NOT_MAPPED;
 
 	int result = P1_SUCCESS;
 
@@ -237,15 +492,14 @@ P3FrameUnmap(int frame)
     result = P3PageTableGet(P1_GetPid(), &table);
 	assert(table != NULL);
     // verify that the process mapped the frame
-	int i;
-	for (i = 0; i < numPages; i++) {
-		if (table[i].incore && table[i].frame == frame) break;
-	}
-	if (i == numPages) return P3_FRAME_NOT_MAPPED;
+	if (P3_frames[frame].mapPid != P1_GetPid()) return P3_FRAME_NOT_MAPPED;
+	int i = P3_frames[frame].mapPage;
+	if (!table[i].incore || table[i].frame != frame) return P3_FRAME_NOT_MAPPED;
 
     // update page's PTE to remove the mapping
 	table[i].incore = 0;
-	frameTable[frame].used = FALSE;
+	P3_frames[frame].mapPid = -1;
+	P3_frames[frame].mapPage = -1;
     // update the page table in the MMU (USLOSS_MmuSetPageTable)
 	result = USLOSS_MmuSetPageTable(table);
 	assert(result == USLOSS_MMU_OK);
@@ -263,20 +517,110 @@ typedef struct Fault {
     // other stuff goes here
 	int			terminate;
 	int			status;
+	PID			next;		// next process in the fault queue, -1 if none
+	int			priority;	// scheduling priority of the faulting process
+	int			key;		// position in the fault queue, see below
+	int			queuedAt;	// time the fault was queued (microseconds)
 } Fault;
 
-int queueSize = 500;
-Fault queue[500];
-int queueStart;
-int queueEnd;
+// A process has at most one outstanding fault, so each process has its own Fault entry.
+static Fault faults[P1_MAXPROC];
+
+// Each pager has its own queue of pending faults. A fault goes to the queue of pager
+// pid % numPagers, so a process's faults keep going to the same pager (and its page table stays
+// warm there) while the pool doesn't change; a pager whose queue is empty steals faults from
+// the others. Live pagers own queues 0 .. numPagers-1.
+//
+// A queue links its faults in order of key. A fault's key is its arrival number plus
+// P3_faultAging times the process's priority, so faults of high-priority processes (lower
+// numbers) go first, but a fault is passed by at most P3_faultAging later faults for each
+// priority level it is below them and can't starve.
+typedef struct PagerQueue {
+	SID			lock;		// protects the fields below
+	SID			wake;		// the pager waits here when it has nothing to do
+	PID			head;		// first fault in the queue, -1 if none
+	PID			tail;
+	int			length;
+	int			idle;		// the pager is waiting on wake
+	int			live;		// a pager owns the queue
+} PagerQueue;
+
+#define PAGER_SLOTS (4*P3_MAX_PAGERS)   // most pagers there can be
+
+static PagerQueue pagerQueues[PAGER_SLOTS];
+
+// Arrival number of the next fault. It only orders faults, so it isn't locked; an increment
+// lost to a preemption just gives two faults the same arrival number.
+static int faultCount;
+
+int P3_faultAging = 8;
+
+// Backpressure: at most P3_maxQueuedFaults faults wait in the queue; further faulting processes
+// wait on faultSlots until a pager takes a fault off the queue.
+int P3_maxQueuedFaults = P1_MAXPROC;
+static int faultSlots;
+
+// Semaphores faulting processes wait on. They are created the first time there are more
+// simultaneous faults than ever before and reused after that.
+static SID waitPool[P1_MAXPROC];
+static int waitPoolFree;        // # of unused semaphores in waitPool
+static int waitPoolCreated;     // # of semaphores created
+
+static SID  WaitSemGet(void);
+
+int numPagers;      // protected by mutex
+int pagerShutdown = FALSE;
+
+// The pool starts with the number of pagers passed to P3PagerInit and grows up to P3_maxPagers
+// when faults back up: a pager that leaves a full batch behind in its queue, or sees that the
+// fault at its head has waited P3_pagerGrowDelay microseconds, forks another pager if none is
+// idle. The pager with the highest-numbered queue retires when it runs out of work after
+// having been idle for P3_pagerIdleTimeout microseconds before its last batch, as long as the
+// pool is larger than it started. Retired pagers are parked rather than quitting, and the pool
+// grows by waking one of them before it forks a new pager, so the pool never has more than
+// maxPagers processes and P3PagerShutdown can wake every one of them.
+int P3_maxPagers = 2*P3_MAX_PAGERS;
+int P3_pagerGrowDelay = 10000;
+int P3_pagerIdleTimeout = 1000000;
+static int minPagers;
+static int maxPagers;
+static int growing;         // a pager is being forked
+static int pagersForked;    // used to name the pagers
+static int pagersAlive;     // pagers forked and not yet quit, protected by mutex
+static int parkedPagers;    // retired pagers waiting on pagerParked, protected by mutex
+static SID pagerParked;
+static SID pagerDone;       // a pager V's it when it quits because of P3PagerShutdown
+
+static void ForkPager(int index, int initial);
+static int  JoinPool(void);
+static int  Now(void);
+
+int P3_readAhead = 4;
+int P3_faultAround = 4;
+
+// Sequential-access detection for read-ahead: the page of each process's last fault and the
+// number of consecutive pages it has faulted on. A process has at most one fault outstanding,
+// so only the pager handling its fault touches its entries.
+static int lastFault[P1_MAXPROC];
+static int sequentialFaults[P1_MAXPROC];
+
+// A pager takes up to PAGER_BATCH faults off a queue at once.
+#define PAGER_BATCH 8
 
-int numPagers;
+static PagerQueue *RouteFault(PID pid);
+static int  QueuedFaults(void);
+static void QueueInsert(PagerQueue *queue, Fault *fault);
+static int  QueueTake(PagerQueue *queue, PID *batch, int max);
+static int  StealFaults(int self, PID *batch);
+static int  WakeIdlePager(void);
+static void HandleFault(Fault *fault);
+static int  NoteFault(PID pid, int page);
+static void MapPage(PID pid, int page, int frame);
+static void FaultAround(PID pid, int page);
 
 // semaphores
 int *pagerIsRunning;
-int faultHappened;
-int faultWaits[500];
-int mutex;
+static int mutex;       // protects the pool of pagers and waitPool; taken before a queue's lock
 /*
  *----------------------------------------------------------------------
  *
@@ -290,21 +634,87 @@ int mutex;
 static void
 FaultHandler(int type, void *arg)
 {
+	// a process suspended by load control stays here until it is resumed
+	P3LoadControl(P1_GetPid(), QueuedFaults());
+	// Minor faults are resolved right here: a first-touch fault that can have a frame the
+	// zeroing daemon already cleared needs no I/O, so it doesn't need a pager either.
+	if (USLOSS_MmuGetCause() != USLOSS_MMU_ACCESS) {
+		PID pid = P1_GetPid();
+		int page = (int) arg / USLOSS_MmuPageSize();
+		int frame;
+		if (P3SwapProbe(pid, page, NULL) == P3_EMPTY_PAGE && P3FrameAllocZeroed(&frame) == P1_SUCCESS) {
+			NoteFault(pid, page);
+			MapPage(pid, page, frame);
+			if (P3_faultAround > 1) {
+				FaultAround(pid, page);
+			}
+			return;
+		}
+	}
 	  // fill in other fields in fault
+	PID pid = P1_GetPid();
+	Fault *fault = &faults[pid];
+	fault->pid = pid;
+	fault->offset = (int) arg;
+	fault->cause = USLOSS_MmuGetCause();
+	fault->terminate = FALSE;
+	fault->status = 0;
+	fault->next = -1;
+	P1_ProcInfo info;
+	int rc = P1_GetProcInfo(pid, &info);
+	assert(rc == P1_SUCCESS);
+	fault->priority = info.priority;
+	// only faults that need a pager count toward the process's fault frequency
+	P3PffFault(pid);
     // add to queue of pending faults
-		P(mutex);
-		int thisIndex = queueEnd;
-		queueEnd = (queueEnd + 1) % queueSize;
-    V(mutex);
-		queue[thisIndex].offset = (int) arg;
-		queue[thisIndex].pid = P1_GetPid();
-		queue[thisIndex].cause = USLOSS_MmuGetCause();
-		// let pagers know there is a pending fault
-		V(faultHappened);
+	P(faultSlots);
+	P(mutex);
+	fault->wait = WaitSemGet();
+	fault->key = faultCount++ + P3_faultAging * fault->priority;
+	fault->queuedAt = Now();
+	PagerQueue *queue = RouteFault(pid);
+	QueueInsert(queue, fault);
+	int wake = queue->idle;
+	queue->idle = FALSE;
+	V(queue->lock);
+	// wake up the pager, or if it is busy, one that can steal the fault
+	if (wake) {
+		V(queue->wake);
+	} else {
+		WakeIdlePager();
+	}
+	V(mutex);
 
     // wait for fault to be handled
-		P(queue[thisIndex].wait);
-		if (queue[thisIndex].terminate) P2_Terminate(queue[thisIndex].status);
+	P(fault->wait);
+	P(mutex);
+	waitPool[waitPoolFree++] = fault->wait;
+	V(mutex);
+	if (fault->terminate) P2_Terminate(fault->status);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WaitSemGet --
+ *
+ *  Takes a semaphore for a faulting process to wait on from waitPool, creating one if
+ *  they are all in use. Must be called with mutex held.
+ *
+ *----------------------------------------------------------------------
+ */
+static SID
+WaitSemGet(void)
+{
+	if (waitPoolFree == 0) {
+		char name[P1_MAXNAME+1];
+		snprintf(name, sizeof(name), "faultWait%d", waitPoolCreated);
+		int rc = P1_SemCreate(name, 0, &waitPool[0]);
+		assert(rc == P1_SUCCESS);
+		waitPoolCreated++;
+		waitPoolFree = 1;
+	}
+	return waitPool[--waitPoolFree];
 }
 
 /*
@@ -333,41 +743,78 @@ P3PagerInit(int pages, int frames, int pagers)
 	if (pagers <= 0 || pagers > P3_MAX_PAGERS) return P3_INVALID_NUM_PAGERS;
 
     // initialize the pager data structures
-	numPagers = pagers;
-	queueStart = 0;
-	queueEnd = 0;
-	pagerIsRunning = (int*) malloc(numPagers*sizeof(int));
-	for (int i = 0; i < numPagers; i++) {
-		char name[5];
-		sprintf(name, "%d.", i);
+	numPagers = 0;
+	minPagers = pagers;
+	maxPagers = (P3_maxPagers > pagers) ? P3_maxPagers : pagers;
+	if (maxPagers > PAGER_SLOTS) maxPagers = PAGER_SLOTS;
+	growing = FALSE;
+	pagersForked = pagers;
+	pagersAlive = pagers;
+	parkedPagers = 0;
+	faultCount = 0;
+	waitPoolFree = 0;
+	waitPoolCreated = 0;
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		lastFault[i] = -1;
+		sequentialFaults[i] = 0;
+	}
+	// the pagers count themselves into numPagers as they start running
+	pagerIsRunning = (int*) malloc(pagers*sizeof(int));
+	for (int i = 0; i < pagers; i++) {
+		char name[P1_MAXNAME+1];
+		snprintf(name, sizeof(name), "pagerRunning%d", i);
 		result = P1_SemCreate(name, 0, pagerIsRunning + i);
 		assert(result == P1_SUCCESS);
 	}
-	result = P1_SemCreate("fault", 0, &faultHappened);
+	result = P1_SemCreate("pagerDone", 0, &pagerDone);
 	assert(result == P1_SUCCESS);
-	result = P1_SemCreate("mutex", 1, &mutex);
+	result = P1_SemCreate("pagerParked", 0, &pagerParked);
 	assert(result == P1_SUCCESS);
-	for (int i = 0; i < queueSize; i++) {
-		char name[5];
-		sprintf(name, "%d*", i);
-		result = P1_SemCreate(name, 0, faultWaits + i);
+	for (int i = 0; i < maxPagers; i++) {
+		char name[P1_MAXNAME+1];
+		snprintf(name, sizeof(name), "pagerLock%d", i);
+		result = P1_SemCreate(name, 1, &pagerQueues[i].lock);
+		assert(result == P1_SUCCESS);
+		snprintf(name, sizeof(name), "pagerWake%d", i);
+		result = P1_SemCreate(name, 0, &pagerQueues[i].wake);
 		assert(result == P1_SUCCESS);
+		pagerQueues[i].head = -1;
+		pagerQueues[i].tail = -1;
+		pagerQueues[i].length = 0;
+		pagerQueues[i].idle = FALSE;
+		pagerQueues[i].live = FALSE;
 	}
+	result = P1_SemCreate("mutex", 1, &mutex);
+	assert(result == P1_SUCCESS);
+	result = P1_SemCreate("faultSlots", P3_maxQueuedFaults > 0 ? P3_maxQueuedFaults : 1, &faultSlots);
+	assert(result == P1_SUCCESS);
     // fork off the pagers and wait for them to start running
-	for (int i = 0; i < numPagers; i++) {
-		char name[5];
-		sprintf(name, "%d", i);
+	for (int i = 0; i < pagers; i++) {
+		ForkPager(i, TRUE);
+		P(pagerIsRunning[i]);
+	}
+	result = P1_SemCreate("zeroWake", 0, &zeroWake);
+	assert(result == P1_SUCCESS);
+	result = P1_SemCreate("zeroDone", 0, &zeroDone);
+	assert(result == P1_SUCCESS);
+	zeroIdle = FALSE;
+	int zeroPid;
+	result = P1_Fork("zero", ZeroDaemon, NULL, USLOSS_MIN_STACK, ZERO_PRIORITY, 0, &zeroPid);
+	assert(result == P1_SUCCESS);
+	pageoutAwake = FALSE;
+	if (lowWater > 0) {
+		result = P1_SemCreate("pageoutWake", 0, &pageoutWake);
+		assert(result == P1_SUCCESS);
+		result = P1_SemCreate("pageoutDone", 0, &pageoutDone);
+		assert(result == P1_SUCCESS);
 		int pid;
-		result = P1_Fork(name, Pager, (void*) i, USLOSS_MIN_STACK, P3_PAGER_PRIORITY, 0, &pid);
+		result = P1_Fork("pageout", PageoutDaemon, NULL, USLOSS_MIN_STACK, PAGEOUT_PRIORITY, 0, &pid);
 		assert(result == P1_SUCCESS);
-		P(pagerIsRunning[i]);
 	}
 	pageInitialized = TRUE;
 	return result;
 }
 
-int pagerShutdown = FALSE;
-
 /*
  *----------------------------------------------------------------------
  *
@@ -389,14 +836,55 @@ P3PagerShutdown(void)
 	
     // cause the pagers to quit
 	pagerShutdown = TRUE;
+	if (lowWater > 0) {
+		V(pageoutWake);
+		P(pageoutDone);
+		assert(P1_SemFree(pageoutWake) == P1_SUCCESS);
+		assert(P1_SemFree(pageoutDone) == P1_SUCCESS);
+	}
+	P(frameMutex);
+	if (zeroIdle) {
+		zeroIdle = FALSE;
+		V(zeroWake);
+	}
+	V(frameMutex);
+	P(zeroDone);
+	assert(P1_SemFree(zeroWake) == P1_SUCCESS);
+	assert(P1_SemFree(zeroDone) == P1_SUCCESS);
+	// Wake up the pagers and wait for all of them to quit before freeing their semaphores.
+	// Pagers are only added or retired under mutex while pagerShutdown is FALSE, so pagersAlive
+	// can't change once it is read here; a pager that is still being forked or unparked quits
+	// when it runs.
+	P(mutex);
+	int alive = pagersAlive;
+	for (int i = 0; i < numPagers; i++) {
+		P(pagerQueues[i].lock);
+		pagerQueues[i].idle = FALSE;
+		V(pagerQueues[i].lock);
+		V(pagerQueues[i].wake);
+	}
+	for (int i = 0; i < parkedPagers; i++) {
+		V(pagerParked);
+	}
+	parkedPagers = 0;
+	V(mutex);
+	for (int i = 0; i < alive; i++) {
+		P(pagerDone);
+	}
     // clean up the pager data structures
-	for (int i = 0; i < numPagers; i++) assert(P1_SemFree(pagerIsRunning[i]) == P1_SUCCESS);
-	for (int i = 0; i < numPagers; i++) V(faultHappened);
-	result = P1_SemFree(faultHappened);
-	assert(result == P1_SUCCESS);
+	for (int i = 0; i < minPagers; i++) assert(P1_SemFree(pagerIsRunning[i]) == P1_SUCCESS);
+	free(pagerIsRunning);
+	assert(P1_SemFree(pagerDone) == P1_SUCCESS);
+	assert(P1_SemFree(pagerParked) == P1_SUCCESS);
+	for (int i = 0; i < maxPagers; i++) {
+		assert(P1_SemFree(pagerQueues[i].lock) == P1_SUCCESS);
+		assert(P1_SemFree(pagerQueues[i].wake) == P1_SUCCESS);
+	}
 	result = P1_SemFree(mutex);
 	assert(result == P1_SUCCESS);
-	for (int i = 0; i < queueSize; i++) assert(P1_SemFree(faultWaits[i]) == P1_SUCCESS);
+	result = P1_SemFree(faultSlots);
+	assert(result == P1_SUCCESS);
+	for (int i = 0; i < waitPoolFree; i++) assert(P1_SemFree(waitPool[i]) == P1_SUCCESS);
     return result;
 }
 
@@ -413,9 +901,11 @@ P3PagerShutdown(void)
 static int
 Pager(void *arg)
 {
+	int self = JoinPool();
+	PagerQueue *queue = &pagerQueues[self];
 
     //notify P3PagerInit that we are running
-	V(pagerIsRunning[(int) arg]);
+	if ((int) arg >= 0) V(pagerIsRunning[(int) arg]);
 	/*
     loop until P3PagerShutdown is called
         wait for a fault
@@ -435,56 +925,663 @@ Pager(void *arg)
         unblock faulting process
 
     **********************************/
-	int rc;
+	PID batch[PAGER_BATCH];
+	int tracks[PAGER_BATCH];
+	int idleFor = 0;    // how long the pager waited for work before its current batch
+	int woke = FALSE;
 	while (!pagerShutdown) {
-		P(faultHappened);
-		if (pagerShutdown) break;
+		int count = QueueTake(queue, batch, PAGER_BATCH);
+		if (count == 0) {
+			count = StealFaults(self, batch);
+		}
+		if (count == 0) {
+			P(mutex);
+			if (!pagerShutdown && self == numPagers - 1 && numPagers > minPagers &&
+				idleFor >= P3_pagerIdleTimeout) {
+				// the pool has had a pager to spare for a while
+				P(queue->lock);
+				int retire = (queue->length == 0);
+				if (retire) {
+					queue->live = FALSE;
+					numPagers--;
+					parkedPagers++;
+				}
+				V(queue->lock);
+				if (retire) {
+					V(mutex);
+					// park until the pool grows again, then take the next queue
+					P(pagerParked);
+					if (pagerShutdown) break;
+					self = JoinPool();
+					queue = &pagerQueues[self];
+					idleFor = 0;
+					woke = FALSE;
+					continue;
+				}
+			}
+			V(mutex);
+			P(queue->lock);
+			if (queue->length > 0 || pagerShutdown) {
+				V(queue->lock);
+				continue;
+			}
+			queue->idle = TRUE;
+			V(queue->lock);
+			int idleStart = Now();
+			P(queue->wake);
+			idleFor = Now() - idleStart;
+			woke = TRUE;
+			continue;
+		}
+		if (!woke) idleFor = 0;
+		woke = FALSE;
+
+		// add a pager if faults are backing up and every pager is busy
+		int grow = -1;
+		int unpark = FALSE;
 		P(mutex);
-		Fault fault = queue[queueStart];
-		int index = queueStart;
-		queueStart = (queueStart + 1) % queueSize;
-		queue[index].terminate = FALSE;
+		P(queue->lock);
+		int backlog = queue->length >= PAGER_BATCH ||
+			(queue->head != -1 && Now() - faults[queue->head].queuedAt >= P3_pagerGrowDelay);
+		V(queue->lock);
+		if (backlog && !pagerShutdown && !growing && numPagers < maxPagers && !WakeIdlePager()) {
+			growing = TRUE;
+			if (parkedPagers > 0) {
+				parkedPagers--;
+				unpark = TRUE;
+			} else {
+				grow = pagersForked++;
+				pagersAlive++;
+			}
+		}
 		V(mutex);
-		if (fault.cause == USLOSS_MMU_ACCESS) {
-			queue[index].terminate = TRUE;
-			queue[index].status = 0;
-			V(fault.wait);
-			continue;
+		if (unpark) {
+			V(pagerParked);
+		} else if (grow != -1) {
+			ForkPager(grow, FALSE);
 		}
-		int frame;
-		for (frame = 0; frame < numFrames; frame++) {
-			if (!frameTable[frame].used) break;
+		for (int i = 0; i < count; i++) {
+			V(faultSlots);
 		}
-		if (frame == numFrames) assert(P3SwapOut(&frame) == P1_SUCCESS);
-		int page = fault.offset/USLOSS_MmuPageSize();
-		rc = P3SwapIn(fault.pid, page, frame);
-		
-		void *addr;
-		if (rc == P3_EMPTY_PAGE) {
+		// Service the faults that need no disk read first, then the swap reads in track order
+		// so the disk arm sweeps across the batch once.
+		for (int i = 0; i < count; i++) {
+			Fault *fault = &faults[batch[i]];
+			int track = -1;
+			if (fault->cause != USLOSS_MMU_ACCESS &&
+				P3SwapProbe(fault->pid, fault->offset/USLOSS_MmuPageSize(), &track) != P1_SUCCESS) {
+				track = -1;
+			}
+			int j;
+			for (j = i; j > 0 && tracks[j - 1] > track; j--) {
+				batch[j] = batch[j - 1];
+				tracks[j] = tracks[j - 1];
+			}
+			batch[j] = fault->pid;
+			tracks[j] = track;
+		}
+		for (int i = 0; i < count; i++) {
+			HandleFault(&faults[batch[i]]);
+		}
+	}
+	V(pagerDone);
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FaultAround --
+ *
+ *  Called after a first-touch fault on page. Zero-fills and maps the other never-touched
+ *  pages of the P3_faultAround-page window that holds page, so a process filling a fresh
+ *  region takes one fault per window instead of one per page. Only done while more than
+ *  highWater frames are free.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+FaultAround(PID pid, int page)
+{
+	USLOSS_PTE *table;
+	int rc = P3PageTableGet(pid, &table);
+	assert(rc == P1_SUCCESS && table != NULL);
+	int start = page - page % P3_faultAround;
+	for (int i = start; i < start + P3_faultAround && i < numPages; i++) {
+		if (i == page || table[i].incore) continue;
+		if (P3_vmStats.freeFrames <= highWater) break;
+		// a page with a copy in swap has been touched before
+		if (P3SwapProbe(pid, i, NULL) != P3_EMPTY_PAGE) continue;
+		int frame;
+		if (P3FrameAllocZeroed(&frame) != P1_SUCCESS && P3FrameAlloc(&frame) != P1_SUCCESS) break;
+		if (!(P3_frames[frame].flags & P3_FRAME_ZEROED)) {
+			void *addr;
 			rc = P3FrameMap(frame, &addr);
 			assert(rc == P1_SUCCESS);
-			for (int i = 0; i < USLOSS_MmuPageSize(); i++) {
-					*((char*)addr + i) = 0;
+			P3PageZero(addr);
+			rc = P3FrameUnmap(frame);
+			assert(rc == P1_SUCCESS);
+		}
+		MapPage(pid, i, frame);
+	}
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * JoinPool --
+ *
+ *  Adds a pager that is starting or coming back from being parked to the pool.
+ *
+ * Results:
+ *   The number of the queue the pager now owns.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+JoinPool(void)
+{
+	P(mutex);
+	int self = numPagers++;
+	PagerQueue *queue = &pagerQueues[self];
+	P(queue->lock);
+	queue->live = TRUE;
+	V(queue->lock);
+	growing = FALSE;
+	V(mutex);
+	return self;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ForkPager --
+ *
+ *  Forks a pager. The pagers forked by P3PagerInit tell it when they are running; the pool
+ *  doesn't grow if a later fork fails.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ForkPager(int index, int initial)
+{
+	char name[P1_MAXNAME+1];
+	snprintf(name, sizeof(name), "pager%d", index);
+	int pid;
+	int rc = P1_Fork(name, Pager, (void *) (initial ? index : -1), USLOSS_MIN_STACK,
+					 P3_PAGER_PRIORITY, 0, &pid);
+	if (rc != P1_SUCCESS) {
+		assert(!initial);
+		P(mutex);
+		growing = FALSE;
+		if (pagerShutdown) {
+			// P3PagerShutdown already counted this pager
+			V(pagerDone);
+		} else {
+			pagersAlive--;
+		}
+		V(mutex);
+	}
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Now --
+ *
+ *  Returns the current time in microseconds.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+Now(void)
+{
+	int now;
+	int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+	assert(rc == USLOSS_DEV_OK);
+	return now;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * QueuedFaults --
+ *
+ *  Counts the faults waiting in the pagers' queues. The queues aren't locked, so the count
+ *  is only an estimate.
+ *
+ * Results:
+ *   The number of faults queued.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+QueuedFaults(void)
+{
+	int queued = 0;
+	for (int i = 0; i < PAGER_SLOTS; i++) {
+		queued += pagerQueues[i].length;
+	}
+	return queued;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RouteFault --
+ *
+ *  Picks the queue for a fault of process pid. Must be called with mutex held, so numPagers
+ *  can't change and the queue's pager can't retire.
+ *
+ * Results:
+ *   The queue, with its lock held.
+ *
+ *----------------------------------------------------------------------
+ */
+static PagerQueue *
+RouteFault(PID pid)
+{
+	assert(numPagers > 0);
+	PagerQueue *queue = &pagerQueues[pid % numPagers];
+	P(queue->lock);
+	assert(queue->live);
+	return queue;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * QueueInsert --
+ *
+ *  Adds a fault to a queue in order of key. Must be called with the queue's lock held.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+QueueInsert(PagerQueue *queue, Fault *fault)
+{
+	fault->next = -1;
+	if (queue->tail == -1 || faults[queue->tail].key <= fault->key) {
+		if (queue->tail == -1) {
+			queue->head = fault->pid;
+		} else {
+			faults[queue->tail].next = fault->pid;
+		}
+		queue->tail = fault->pid;
+	} else {
+		PID *prev = &queue->head;
+		while (faults[*prev].key <= fault->key) {
+			prev = &faults[*prev].next;
+		}
+		fault->next = *prev;
+		*prev = fault->pid;
+	}
+	queue->length++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * QueueTake --
+ *
+ *  Takes up to max faults off the front of a queue. They all have the priority of the first
+ *  one, so sorting the batch by track can't put a low-priority fault ahead of a high-priority
+ *  one.
+ *
+ * Results:
+ *   The number of faults put in batch.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+QueueTake(PagerQueue *queue, PID *batch, int max)
+{
+	int count = 0;
+	P(queue->lock);
+	if (queue->head != -1) {
+		int priority = faults[queue->head].priority;
+		while (queue->head != -1 && count < max && faults[queue->head].priority == priority) {
+			batch[count++] = queue->head;
+			queue->head = faults[queue->head].next;
+		}
+		if (queue->head == -1) queue->tail = -1;
+		queue->length -= count;
+	}
+	V(queue->lock);
+	return count;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StealFaults --
+ *
+ *  Called by pager self when its queue is empty. Takes up to half of the faults from the
+ *  queue whose first fault should be served first.
+ *
+ * Results:
+ *   The number of faults put in batch.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+StealFaults(int self, PID *batch)
+{
+	PagerQueue *victim = NULL;
+	int victimKey = 0;
+	// pick a queue without locking them all; QueueTake copes if it has changed since
+	for (int i = 0; i < numPagers; i++) {
+		PID head = pagerQueues[i].head;
+		if (i == self || head == -1) continue;
+		if (victim == NULL || faults[head].key < victimKey) {
+			victim = &pagerQueues[i];
+			victimKey = faults[head].key;
+		}
+	}
+	if (victim == NULL) return 0;
+	int max = (victim->length + 1) / 2;
+	if (max > PAGER_BATCH) max = PAGER_BATCH;
+	return QueueTake(victim, batch, max > 0 ? max : 1);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WakeIdlePager --
+ *
+ *  Wakes up an idle pager, if there is one, so it can steal faults from a busy one. Call it
+ *  with mutex held.
+ *
+ * Results:
+ *   TRUE if a pager was woken up.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+WakeIdlePager(void)
+{
+	for (int i = 0; i < numPagers; i++) {
+		PagerQueue *queue = &pagerQueues[i];
+		if (!queue->idle) continue;
+		P(queue->lock);
+		int wake = queue->idle;
+		queue->idle = FALSE;
+		V(queue->lock);
+		if (wake) {
+			V(queue->wake);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * HandleFault --
+ *
+ *  Services a fault taken off the queue and wakes up the faulting process.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+HandleFault(Fault *fault)
+{
+	int rc;
+	if (fault->cause == USLOSS_MMU_ACCESS) {
+		fault->terminate = TRUE;
+		fault->status = 0;
+		V(fault->wait);
+		return;
+	}
+	int frame;
+	while (1) {
+		rc = P3FrameAlloc(&frame);
+		if (rc != P3_OUT_OF_FRAMES) break;
+		// the victim comes back still allocated, so it goes straight to this fault
+		rc = P3SwapOut(&frame);
+		if (rc != P3_OUT_OF_FRAMES) break;
+		// every frame is busy; wait for one to be released or mapped
+		P(frameMutex);
+		if (freeCount + zeroCount == 0) {
+			frameWaiters++;
+			V(frameMutex);
+			P(frameAvailable);
+		} else {
+			V(frameMutex);
+		}
+	}
+	assert(rc == P1_SUCCESS);
+	int page = fault->offset/USLOSS_MmuPageSize();
+	int sequential = NoteFault(fault->pid, page);
+
+	// A process that faults on consecutive pages is probably scanning its region, so read
+	// the pages that follow along with this one. Read-ahead only uses frames that are
+	// free anyway; it never evicts. Frames are only taken for pages that are in swap;
+	// P3SwapInRun reads those whose slots follow the page's, and the rest go back.
+	int frames[P3_MAX_SWAP_CLUSTER];
+	int ahead = 0;
+	frames[0] = frame;
+	if (sequential >= 2 && P3SwapProbe(fault->pid, page, NULL) == P1_SUCCESS) {
+		while (ahead < P3_readAhead && ahead < P3_MAX_SWAP_CLUSTER - 1 &&
+			   page + ahead + 1 < numPages && P3_vmStats.freeFrames > lowWater &&
+			   P3SwapProbe(fault->pid, page + ahead + 1, NULL) == P1_SUCCESS &&
+			   P3FrameAlloc(&frames[ahead + 1]) == P1_SUCCESS) {
+			ahead++;
+		}
+	}
+	int read = 1;
+	if (ahead > 0) {
+		rc = P3SwapInRun(fault->pid, page, frames, ahead + 1, &read);
+		if (rc != P1_SUCCESS) read = 1;
+		for (int i = 1; i < ahead + 1; i++) {
+			if (i < read) {
+				MapPage(fault->pid, page + i, frames[i]);
+			} else {
+				int rc2 = P3FrameRelease(frames[i]);
+				assert(rc2 == P1_SUCCESS);
 			}
+		}
+		if (read > 1) {
+			// the next fault of the scan is past the pages just read
+			lastFault[fault->pid] = page + read - 1;
+		}
+	} else {
+		rc = P3SwapIn(fault->pid, page, frame);
+	}
+	
+	void *addr;
+	int firstTouch = (rc == P3_EMPTY_PAGE);
+	if (rc == P3_EMPTY_PAGE) {
+		// trade the frame for a zeroed one if there is one, otherwise zero it here
+		int zeroed;
+		if (!(P3_frames[frame].flags & P3_FRAME_ZEROED) &&
+			P3FrameAllocZeroed(&zeroed) == P1_SUCCESS) {
+			rc = P3FrameRelease(frame);
+			assert(rc == P1_SUCCESS);
+			frame = zeroed;
+		}
+		if (!(P3_frames[frame].flags & P3_FRAME_ZEROED)) {
+			rc = P3FrameMap(frame, &addr);
+			assert(rc == P1_SUCCESS);
+			P3PageZero(addr);
 			rc = P3FrameUnmap(frame);
 			assert(rc == P1_SUCCESS);
+		}
+	} else if (rc == P3_OUT_OF_SWAP) {
+		rc = P3FrameRelease(frame);
+		assert(rc == P1_SUCCESS);
+		fault->terminate = TRUE;
+		fault->status = P3_OUT_OF_SWAP;
+		V(fault->wait);
+		return;
+	}
+	MapPage(fault->pid, page, frame);
+	if (firstTouch && P3_faultAround > 1) {
+		FaultAround(fault->pid, page);
+	}
+	V(fault->wait);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NoteFault --
+ *
+ *  Records a fault of a process for sequential-access detection.
+ *
+ * Results:
+ *   The number of consecutive pages the process has faulted on, ending with page.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+NoteFault(PID pid, int page)
+{
+	if (page == lastFault[pid] + 1) {
+		sequentialFaults[pid]++;
+	} else {
+		sequentialFaults[pid] = 1;
+	}
+	lastFault[pid] = page;
+	return sequentialFaults[pid];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapPage --
+ *
+ *  Maps a page of a process to the frame a pager filled for it and makes the frame a
+ *  candidate for replacement.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+MapPage(PID pid, int page, int frame)
+{
+	// get the page table for the process (P3PageTableGet)
+	USLOSS_PTE *table;
+	int rc = P3PageTableGet(pid, &table);
+	assert(rc == P1_SUCCESS && table != NULL);
+	table[page].incore = 1;
+	table[page].read = 1;
+	table[page].write = 1;
+	table[page].frame = frame;
+	// the frame only becomes a replacement candidate once the PTE maps it
+	if (P3_policy != NULL) P3_policy->mapped(frame);
+	P(frameMutex);
+	P3_frames[frame].pid = pid;
+	P3_frames[frame].page = page;
+	P3_frames[frame].flags &= ~P3_FRAME_ZEROED;
+	P3_frames[frame].state = P3_FRAME_INUSE;
+	FrameAvailable();
+	V(frameMutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PageoutDaemon --
+ *
+ *  Evicts pages ahead of demand. Sleeps until the number of free frames
+ *  drops below the low watermark, then runs the clock (P3SwapOut) and
+ *  releases the victims until the high watermark is reached.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PageoutDaemon(void *arg)
+{
+	int rc;
+	while (1) {
+		P(pageoutWake);
+		if (pagerShutdown) break;
+		while (!pagerShutdown && P3_vmStats.freeFrames < highWater) {
+			int frame = -1;
+			rc = P3SwapOut(&frame);
+			if (rc != P1_SUCCESS || frame == -1) break;
+			rc = P3FrameRelease(frame);
+			assert(rc == P1_SUCCESS);
+		}
+		P(frameMutex);
+		pageoutAwake = FALSE;
+		V(frameMutex);
+	}
+	V(pageoutDone);
+	return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ZeroDaemon --
+ *
+ *  Zeroes free frames when nothing else is running. Takes a frame off
+ *  freeList, clears it, and puts it on zeroList, sleeping whenever
+ *  freeList is empty.
+ *
+ *----------------------------------------------------------------------
+ */
 
-		} else if (rc == P3_OUT_OF_SWAP) {
-			queue[index].terminate = TRUE;
-			queue[index].status = P3_OUT_OF_SWAP;
-			V(fault.wait);
+static int
+ZeroDaemon(void *arg)
+{
+	int rc;
+	while (1) {
+		P(frameMutex);
+		// checked with frameMutex held so that P3PagerShutdown sees zeroIdle if we go to sleep
+		if (pagerShutdown) {
+			V(frameMutex);
+			break;
+		}
+		if (freeCount == 0) {
+			zeroIdle = TRUE;
+			V(frameMutex);
+			P(zeroWake);
 			continue;
 		}
-		// get the page table for the process (P3PageTableGet)
-		USLOSS_PTE *table;
-    	rc = P3PageTableGet(fault.pid, &table);
-		assert(table != NULL);
-		frameTable[frame].used = TRUE;
-		table[page].incore = 1;
-		table[page].read = 1;
-		table[page].write = 1;
-		table[page].frame = frame;
-		V(fault.wait);
+		int frame = freeList[--freeCount];
+		P3_frames[frame].state = P3_FRAME_BUSY;
+		// the frame can't be allocated while it is being zeroed, so it doesn't count as free
+		P3_vmStats.freeFrames--;
+		V(frameMutex);
+
+		void *addr;
+		rc = P3FrameMap(frame, &addr);
+		assert(rc == P1_SUCCESS);
+		P3PageZero(addr);
+		rc = P3FrameUnmap(frame);
+		assert(rc == P1_SUCCESS);
+
+		P(frameMutex);
+		P3_frames[frame].state = P3_FRAME_FREE;
+		P3_frames[frame].flags |= P3_FRAME_ZEROED;
+		zeroList[zeroCount++] = frame;
+		P3_vmStats.freeFrames++;
+		FrameAvailable();
+		V(frameMutex);
+	}
+	V(zeroDone);
+	return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FrameAvailable --
+ *
+ *  Wakes up a pager waiting for a frame. Must be called with frameMutex held.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FrameAvailable(void)
+{
+	if (frameWaiters > 0) {
+		frameWaiters--;
+		V(frameAvailable);
 	}
-    return 0;
 }
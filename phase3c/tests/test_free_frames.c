@@ -0,0 +1,123 @@
+/*
+ * test_free_frames.c
+ *  
+ *  Tests that frames are taken from and returned to the pool of free frames. Two children
+ *  touch all of their pages, so all frames are in use while they run. Once they have quit
+ *  every frame should be free again.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 3             // # of pages per process
+#define CHILDREN 2          // # of children
+#define FRAMES ((PAGES) * (CHILDREN))
+#define PAGERS 2            // # of pagers
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+int debugging = 1;
+#else
+int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static int
+Child(void *arg)
+{
+    int     j;
+    char    *page;
+    int     pid;
+
+    Sys_GetPID(&pid);
+    Debug("Child (%d) starting.\n", pid);
+
+    for (j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        Debug("Child (%d) touching page %d @ %p\n", pid, j, page);
+        TEST(page[0], '\0');
+        page[0] = 'A';
+    }
+    Debug("Child (%d) done.\n", pid);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     i;
+    int     rc;
+    int     pid;
+    int     status;
+
+    Debug("P4_Startup starting.\n");
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion);
+    TEST(rc, P1_SUCCESS);
+    TEST(P3_vmStats.freeFrames, FRAMES);
+
+    pageSize = USLOSS_MmuPageSize();
+    for (i = 0; i < CHILDREN; i++) {
+        rc = Sys_Spawn(MakeName("Child", i), Child, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (i = 0; i < CHILDREN; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    Debug("Children terminated\n");
+    TEST(P3_vmStats.freeFrames, FRAMES);
+    Sys_VmShutdown();
+    PASSED();
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
+
+// Phase 3d stubs
+
+#include "phase3Int.h"
+
+int P3SwapInit(int pages, int frames) {return P1_SUCCESS;}
+int P3SwapShutdown(void) {return P1_SUCCESS;}
+int P3SwapFreeAll(PID pid) {return P1_SUCCESS;}
+int P3SwapOut(int *frame) {return P1_SUCCESS;}
+int P3SwapProbe(PID pid, int page, int *track) {return P3_EMPTY_PAGE;}
+int P3SwapInRun(PID pid, int page, int *frames, int count, int *read) {
+    *read = 1;
+    return P3SwapIn(pid, page, frames[0]);
+}
+int P3SwapIn(PID pid, int page, int frame) {return P3_EMPTY_PAGE;}
+void P3PffFault(PID pid) {}
+void P3LoadControl(PID pid, int queued) {}
@@ -106,6 +106,13 @@ int P3SwapInit(int pages, int frames) {return P1_SUCCESS;}
 int P3SwapShutdown(void) {return P1_SUCCESS;}
 int P3SwapFreeAll(PID pid) {return P1_SUCCESS;}
 int P3SwapOut(int *frame) {return P1_SUCCESS;}
+int P3SwapProbe(PID pid, int page, int *track) {return P1_SUCCESS;}
+void P3PffFault(PID pid) {}
+void P3LoadControl(PID pid, int queued) {}
+int P3SwapInRun(PID pid, int page, int *frames, int count, int *read) {
+    *read = 1;
+    return P3SwapIn(pid, page, frames[0]);
+}
 int P3SwapIn(PID pid, int page, int frame) {
     int rc = 0;
     void *addr;
@@ -101,7 +101,14 @@ int P3SwapInit(int pages, int frames) {return P1_SUCCESS;}
 int P3SwapShutdown(void) {return P1_SUCCESS;}
 int P3SwapFreeAll(PID pid) {return P1_SUCCESS;}
 int P3SwapOut(int *frame) {return P1_SUCCESS;}
+int P3SwapProbe(PID pid, int page, int *track) {return P3_OUT_OF_SWAP;}
+int P3SwapInRun(PID pid, int page, int *frames, int count, int *read) {
+    *read = 1;
+    return P3SwapIn(pid, page, frames[0]);
+}
 int P3SwapIn(PID pid, int page, int frame) {return P3_OUT_OF_SWAP;}
+void P3PffFault(PID pid) {}
+void P3LoadControl(PID pid, int queued) {}
 
 
 
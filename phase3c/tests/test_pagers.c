@@ -0,0 +1,136 @@
+/*
+ * test_pagers.c
+ *
+ *  Tests that the pagers P3PagerInit forks service major faults. P3SwapProbe says every page
+ *  is in swap, so every fault goes to a pager, and P3SwapIn fills the page with its page
+ *  number. Several children fault at once so their faults go to every pager's queue.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 4                 // # of pages per process
+#define CHILDREN 4              // # of children
+#define FRAMES (PAGES*CHILDREN) // # of frames
+#define PAGERS 2                // # of pagers
+
+static char *vmRegion;
+static int  pageSize;
+static int  swapIns = 0;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+int debugging = 1;
+#else
+int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+static int
+Child(void *arg)
+{
+    int     j;
+    char    *page;
+    int     pid;
+
+    Sys_GetPID(&pid);
+    Debug("Child (%d) starting.\n", pid);
+
+    // Pages should be filled with their page numbers.
+    for (j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        Debug("Child (%d) reading from page %d @ %p\n", pid, j, page);
+        for (int k = 0; k < pageSize; k++) {
+            TEST(page[k], j);
+        }
+    }
+    Debug("Child (%d) done.\n", pid);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    Debug("P4_Startup starting.\n");
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion);
+    TEST(rc, P1_SUCCESS);
+
+
+    pageSize = USLOSS_MmuPageSize();
+    for (int i = 0; i < CHILDREN; i++) {
+        rc = Sys_Spawn("Child", Child, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (int i = 0; i < CHILDREN; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    Debug("Children terminated\n");
+    // every page of every child was read in by a pager
+    TEST(swapIns, PAGES * CHILDREN);
+    Sys_VmShutdown();
+    PASSED();
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
+
+// Phase 3d stubs
+
+#include "phase3Int.h"
+
+int P3SwapInit(int pages, int frames) {return P1_SUCCESS;}
+int P3SwapShutdown(void) {return P1_SUCCESS;}
+int P3SwapFreeAll(PID pid) {return P1_SUCCESS;}
+int P3SwapOut(int *frame) {return P1_SUCCESS;}
+int P3SwapProbe(PID pid, int page, int *track) {return P1_SUCCESS;}
+void P3PffFault(PID pid) {}
+void P3LoadControl(PID pid, int queued) {}
+int P3SwapInRun(PID pid, int page, int *frames, int count, int *read) {
+    *read = 1;
+    return P3SwapIn(pid, page, frames[0]);
+}
+int P3SwapIn(PID pid, int page, int frame) {
+    int rc = 0;
+    void *addr;
+    Debug("P3SwapIn PID %d page %d frame %d.\n", pid, page, frame);
+    swapIns++;
+    rc = P3FrameMap(frame, &addr);
+    TEST(rc, P1_SUCCESS);
+    memset(addr, page, pageSize);
+    rc = P3FrameUnmap(frame);
+    TEST(rc, P1_SUCCESS);
+    return P1_SUCCESS;
+}
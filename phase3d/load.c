@@ -0,0 +1,359 @@
+/*
+ * load.c
+ *
+ *  Load control. When the processes' working sets don't fit in memory together every process
+ *  faults all the time and little gets done. A daemon checks every P3_loadInterval seconds
+ *  whether the system is thrashing: in the last interval the processes faulted in at least
+ *  P3_thrashTurnover percent of the frames and the pagers had at least P3_thrashQueue faults
+ *  waiting. If so it suspends the lowest-priority process that is still running (the one
+ *  that faulted most among equals), as long as another one keeps running. Once the fault
+ *  rate has dropped below half the threshold it resumes the highest-priority suspended
+ *  process, one per interval.
+ *
+ *  The daemon pages a process out as soon as it suspends it (P3SwapOutProcess), so its frames
+ *  go straight to the free pool. With none of its pages in memory the process faults on its
+ *  next memory access and is parked in P3LoadControl until it is resumed. Pages the pagers
+ *  were already bringing in for it are the first P3SwapOut evicts (P3PffRank).
+ *
+ *  loadLock protects the per-process state and the counters, except that P3LoadControl counts
+ *  faults without it: the counts only steer the daemon, and an increment lost to the daemon
+ *  starting a new interval doesn't matter. Nothing else is acquired while it is held.
+ */
+
+#include <assert.h>
+#include <phase1.h>
+#include <usloss.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "phase3.h"
+#include "phase3Int.h"
+
+int P3_loadControl = FALSE;
+int P3_loadInterval = 1;
+int P3_thrashTurnover = 100;
+int P3_thrashQueue = 2;
+
+P3LoadStats P3_loadStats;
+
+#define LOAD_PRIORITY   P3_PAGER_PRIORITY
+
+typedef struct Load {
+	int     active;         // the process has faulted since it last freed its swap space
+	int     suspended;
+	int     parked;         // the process is waiting on park
+	SID     park;           // created the first time the process is parked, -1 until then
+	int     faults;         // # of faults in the current interval
+} Load;
+
+static Load load[P1_MAXPROC];
+
+static int initialized = FALSE;
+static int numFrames;
+static SID loadLock;
+static int faults;          // # of faults in the current interval, all processes
+static int maxQueued;       // most faults waiting for a pager seen in the current interval
+static int daemonRunning;   // P3_loadControl was on at P3LoadInit
+static P3Ticker *loadTicker;
+static SID loadDone;
+
+static void P(int sid) {
+	assert(P1_P(sid) == P1_SUCCESS);
+}
+
+static void V(int sid) {
+	assert(P1_V(sid) == P1_SUCCESS);
+}
+
+static int  LoadDaemon(void *arg);
+static int  Suspend(void);
+static void Resume(int all);
+static void Unpark(Load *l);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3LoadInit --
+ *
+ *  Initializes load control and, if P3_loadControl is on, starts its daemon.
+ *
+ * Results:
+ *   P3_ALREADY_INITIALIZED:    this function has already been called
+ *   P1_SUCCESS:                success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3LoadInit(int frames)
+{
+	if (initialized) return P3_ALREADY_INITIALIZED;
+	numFrames = frames;
+	int rc = P1_SemCreate("loadLock", 1, &loadLock);
+	assert(rc == P1_SUCCESS);
+	rc = P1_SemCreate("loadDone", 0, &loadDone);
+	assert(rc == P1_SUCCESS);
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		load[i].park = -1;
+		load[i].active = FALSE;
+		load[i].suspended = FALSE;
+		load[i].parked = FALSE;
+		load[i].faults = 0;
+	}
+	faults = 0;
+	maxQueued = 0;
+	memset(&P3_loadStats, 0, sizeof(P3_loadStats));
+	initialized = TRUE;
+	daemonRunning = P3_loadControl;
+	if (daemonRunning) {
+		loadTicker = P3TickerStart("load", &P3_loadInterval, LOAD_PRIORITY);
+		int pid;
+		rc = P1_Fork("load", LoadDaemon, NULL, USLOSS_MIN_STACK, LOAD_PRIORITY, 0, &pid);
+		assert(rc == P1_SUCCESS);
+	}
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3LoadShutdown --
+ *
+ *  Stops the daemon, resumes every suspended process, and cleans up.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3LoadInit has not been called
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3LoadShutdown(void)
+{
+	if (!initialized) return P3_NOT_INITIALIZED;
+	if (daemonRunning) {
+		P3TickerStop(loadTicker);
+		P(loadDone);
+	}
+	P(loadLock);
+	initialized = FALSE;
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		load[i].suspended = FALSE;
+		Unpark(&load[i]);
+	}
+	V(loadLock);
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		if (load[i].park != -1) assert(P1_SemFree(load[i].park) == P1_SUCCESS);
+	}
+	assert(P1_SemFree(loadDone) == P1_SUCCESS);
+	assert(P1_SemFree(loadLock) == P1_SUCCESS);
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3LoadControl --
+ *
+ *  Called by a process when it faults, before its fault is queued. Counts the fault and
+ *  the number of faults already waiting for a pager, then parks the process for as long as
+ *  it is suspended.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3LoadControl(PID pid, int queued)
+{
+	if (!initialized || !daemonRunning || pid < 0 || pid >= P1_MAXPROC) return;
+	Load *l = &load[pid];
+	l->active = TRUE;
+	l->faults++;
+	faults++;
+	if (queued > maxQueued) maxQueued = queued;
+	// The daemon suspends a process before it pages it out, so the faults that follow see
+	// suspended set. Only a suspended process needs the lock.
+	if (!l->suspended) return;
+	P(loadLock);
+	while (P3_loadControl && l->suspended) {
+		if (l->park == -1) {
+			char name[P1_MAXNAME+1];
+			snprintf(name, sizeof(name), "park%d", pid);
+			int rc = P1_SemCreate(name, 0, &l->park);
+			assert(rc == P1_SUCCESS);
+		}
+		l->parked = TRUE;
+		V(loadLock);
+		P(l->park);
+		P(loadLock);
+	}
+	V(loadLock);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3LoadSuspended --
+ *
+ * Results:
+ *   TRUE if load control has suspended the process.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3LoadSuspended(PID pid)
+{
+	if (!initialized || !daemonRunning) return FALSE;
+	P(loadLock);
+	int suspended = load[pid].suspended;
+	V(loadLock);
+	return suspended;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3LoadExit --
+ *
+ *  Forgets the process; called when it frees its swap space.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3LoadExit(PID pid)
+{
+	if (!initialized) return;
+	P(loadLock);
+	load[pid].active = FALSE;
+	load[pid].suspended = FALSE;
+	load[pid].faults = 0;
+	Unpark(&load[pid]);
+	V(loadLock);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LoadDaemon --
+ *
+ *  Every P3_loadInterval seconds, decides from the last interval's fault count and queue
+ *  depth whether to suspend or resume a process, then starts a new interval. A process it
+ *  suspends is paged out.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+LoadDaemon(void *arg)
+{
+	while (P3TickerWait(loadTicker)) {
+		P(loadLock);
+		int threshold = numFrames * P3_thrashTurnover / 100;
+		int suspended = -1;
+		if (!P3_loadControl) {
+			Resume(TRUE);
+		} else if (faults >= threshold && maxQueued >= P3_thrashQueue) {
+			suspended = Suspend();
+		} else if (faults < threshold / 2) {
+			Resume(FALSE);
+		}
+		faults = 0;
+		maxQueued = 0;
+		for (int i = 0; i < P1_MAXPROC; i++) {
+			load[i].faults = 0;
+		}
+		V(loadLock);
+		if (suspended != -1) {
+			// take its frames away now instead of waiting for them to be replaced
+			int evicted;
+			int rc = P3SwapOutProcess(suspended, &evicted);
+			assert(rc == P1_SUCCESS);
+			P(loadLock);
+			P3_loadStats.pagedOut += evicted;
+			V(loadLock);
+		}
+	}
+	V(loadDone);
+	return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Suspend, Resume --
+ *
+ *  Suspend the lowest-priority running process, breaking ties by the most faults this
+ *  interval, unless it is the only one running. Resume the highest-priority suspended
+ *  process, or every suspended process if all is TRUE. Call them with loadLock held.
+ *
+ * Results:
+ *   Suspend returns the process it suspended, -1 if none.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+Suspend(void)
+{
+	int victim = -1;
+	int victimPriority = 0;
+	int running = 0;
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		Load *l = &load[i];
+		if (!l->active || l->suspended) continue;
+		P1_ProcInfo info;
+		if (P1_GetProcInfo(i, &info) != P1_SUCCESS) continue;
+		running++;
+		// a larger number is a lower priority
+		if (victim == -1 || info.priority > victimPriority ||
+			(info.priority == victimPriority && l->faults > load[victim].faults)) {
+			victim = i;
+			victimPriority = info.priority;
+		}
+	}
+	if (running < 2) return -1;
+	load[victim].suspended = TRUE;
+	P3_loadStats.suspends++;
+	return victim;
+}
+
+static void
+Resume(int all)
+{
+	int chosen = -1;
+	int chosenPriority = 0;
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		if (!load[i].suspended) continue;
+		if (all) {
+			load[i].suspended = FALSE;
+			P3_loadStats.resumes++;
+			Unpark(&load[i]);
+			continue;
+		}
+		P1_ProcInfo info;
+		int priority = (P1_GetProcInfo(i, &info) == P1_SUCCESS) ? info.priority : 0;
+		if (chosen == -1 || priority < chosenPriority) {
+			chosen = i;
+			chosenPriority = priority;
+		}
+	}
+	if (chosen != -1) {
+		load[chosen].suspended = FALSE;
+		P3_loadStats.resumes++;
+		Unpark(&load[chosen]);
+	}
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Unpark --
+ *
+ *  Wakes up the process if it is parked. Call it with loadLock held.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+Unpark(Load *l)
+{
+	if (l->parked) {
+		l->parked = FALSE;
+		V(l->park);
+	}
+}
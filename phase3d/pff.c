@@ -0,0 +1,305 @@
+/*
+ * pff.c
+ *
+ *  Page-fault-frequency control of per-process frame allocation. Every major fault (one that
+ *  goes to a pager) is counted against its process over a sliding window of P3_pffWindow
+ *  microseconds. Each process has a frame target: while a process faults more than
+ *  P3_pffHigh times per window its target grows past its resident set, and at the end of
+ *  each window in which it faulted fewer than P3_pffLow times its target shrinks by a quarter.
+ *
+ *  Replacement stays global, but P3SwapOut ranks the replacement policy's candidates by their
+ *  process (P3PffRank), using ranks P3PffUpdate computes once per eviction: first pages of
+ *  processes suspended by load control (load.c), then of processes holding more frames than
+ *  their target, then of processes that rarely fault, then the rest.
+ *
+ *  pffLock protects the per-process state. Nothing else is acquired while it is held.
+ */
+
+#include <assert.h>
+#include <phase1.h>
+#include <usloss.h>
+
+#include "phase3.h"
+#include "phase3Int.h"
+
+int P3_pff = TRUE;
+int P3_pffWindow = 1000000;
+int P3_pffHigh = 8;
+int P3_pffLow = 2;
+
+typedef struct Pff {
+	int     active;         // the process has faulted since its state was last reset
+	int     windowStart;    // when the current window started
+	int     faults;         // # of faults in the current window
+	int     lastFaults;     // # of faults in the previous window
+	int     target;         // # of frames the process should have
+	int     resident;       // # of frames it had at the last P3PffUpdate
+} Pff;
+
+static Pff pff[P1_MAXPROC];
+static int ranks[P1_MAXPROC];   // as of the last P3PffUpdate
+
+static int initialized = FALSE;
+static int numFrames;
+static SID pffLock;
+
+static void P(int sid) {
+	assert(P1_P(sid) == P1_SUCCESS);
+}
+
+static void V(int sid) {
+	assert(P1_V(sid) == P1_SUCCESS);
+}
+
+static void Reset(Pff *p);
+static void Roll(Pff *p, int now);
+static int  Rate(Pff *p, int now);
+static int  Rank(Pff *p, int now);
+static int  Now(void);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PffInit --
+ *
+ *  Initializes the page-fault-frequency state.
+ *
+ * Results:
+ *   P3_ALREADY_INITIALIZED:    this function has already been called
+ *   P1_SUCCESS:                success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3PffInit(int frames)
+{
+	if (initialized) return P3_ALREADY_INITIALIZED;
+	numFrames = frames;
+	int rc = P1_SemCreate("pffLock", 1, &pffLock);
+	assert(rc == P1_SUCCESS);
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		Reset(&pff[i]);
+		ranks[i] = 1;
+	}
+	initialized = TRUE;
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PffShutdown --
+ *
+ *  Cleans up the page-fault-frequency state.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3PffInit has not been called
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3PffShutdown(void)
+{
+	if (!initialized) return P3_NOT_INITIALIZED;
+	initialized = FALSE;
+	int rc = P1_SemFree(pffLock);
+	assert(rc == P1_SUCCESS);
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PffFault --
+ *
+ *  Counts a major page fault by the process. If the process is faulting too often its target
+ *  grows to one frame more than it has.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3PffFault(PID pid)
+{
+	if (!initialized || pid < 0 || pid >= P1_MAXPROC) return;
+	P(pffLock);
+	Pff *p = &pff[pid];
+	int now = Now();
+	if (!p->active) {
+		p->active = TRUE;
+		p->windowStart = now;
+	}
+	Roll(p, now);
+	p->faults++;
+	if (Rate(p, now) > P3_pffHigh) {
+		int target = p->resident + 1;
+		if (target > numFrames) target = numFrames;
+		if (p->target < target) p->target = target;
+	}
+	V(pffLock);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PffExit --
+ *
+ *  Forgets the process's fault history; called when it frees its swap space.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3PffExit(PID pid)
+{
+	if (!initialized) return;
+	P(pffLock);
+	Reset(&pff[pid]);
+	V(pffLock);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PffUpdate --
+ *
+ *  Counts the frames each process has, ends the windows that have run out and ranks every
+ *  process for P3PffRank. Called before selecting victims, with clockMutex held.
+ *
+ * Results:
+ *   The best (lowest) rank of any process that has frames.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3PffUpdate(void)
+{
+	if (!initialized) return 0;
+	P(pffLock);
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		pff[i].resident = 0;
+	}
+	for (int frame = 0; frame < numFrames; frame++) {
+		PID pid = P3_frames[frame].pid;
+		if (P3_frames[frame].state == P3_FRAME_INUSE && pid >= 0) {
+			pff[pid].resident++;
+		}
+	}
+	int now = Now();
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		Pff *p = &pff[i];
+		Roll(p, now);
+		ranks[i] = P3_pff ? Rank(p, now) : 1;
+	}
+	V(pffLock);
+	// the resident counts and ranks are only written here, and the caller keeps this from
+	// running twice
+	int best = -1;
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		if (pff[i].resident == 0) continue;
+		if (P3LoadSuspended(i)) ranks[i] = 0;
+		if (best == -1 || ranks[i] < best) best = ranks[i];
+	}
+	return best == -1 ? 1 : best;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PffRank --
+ *
+ *  Ranks the process's pages for eviction, as of the last P3PffUpdate. Takes no locks, so
+ *  it costs nothing per candidate.
+ *
+ * Results:
+ *   0 if load control has suspended the process (P3LoadSuspended), 1 if it has more frames
+ *   than its target, 2 if it rarely faults, 3 otherwise. Always 1 for a process that isn't
+ *   suspended if P3_pff is off.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3PffRank(PID pid)
+{
+	if (!initialized) return 0;
+	return ranks[pid];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Reset, Roll, Rate, Rank --
+ *
+ *  Helpers for a process's state; call them with pffLock held. Roll starts new windows until
+ *  the current one contains now, shrinking the target for each window that saw few faults.
+ *  Rate is the number of faults in the last P3_pffWindow microseconds, counting the part of
+ *  the previous window that is still inside it.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+Reset(Pff *p)
+{
+	p->active = FALSE;
+	p->windowStart = 0;
+	p->faults = 0;
+	p->lastFaults = 0;
+	p->target = 0;
+	p->resident = 0;
+}
+
+static void
+Roll(Pff *p, int now)
+{
+	int window = P3_pffWindow > 0 ? P3_pffWindow : 1;
+	if (!p->active) return;
+	while (now - p->windowStart >= window) {
+		p->lastFaults = p->faults;
+		p->faults = 0;
+		p->windowStart += window;
+		if (p->lastFaults < P3_pffLow) {
+			p->target -= p->target / 4;
+			if (p->lastFaults == 0 && p->target > 0) p->target--;
+		}
+		if (p->lastFaults == 0 && p->target == 0) {
+			// idle: skip the rest of the empty windows at once
+			p->windowStart = now;
+		}
+	}
+}
+
+static int
+Rate(Pff *p, int now)
+{
+	int window = P3_pffWindow > 0 ? P3_pffWindow : 1;
+	int elapsed = now - p->windowStart;
+	return p->faults + (int) ((long long) p->lastFaults * (window - elapsed) / window);
+}
+
+static int
+Rank(Pff *p, int now)
+{
+	if (p->resident > p->target) return 1;
+	if (Rate(p, now) < P3_pffLow) return 2;
+	return 3;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Now --
+ *
+ *  Returns the current time from the USLOSS clock.
+ *
+ * Results:
+ *   The time in microseconds.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+Now(void)
+{
+	int now;
+	int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+	assert(rc == USLOSS_DEV_OK);
+	return now;
+}
@@ -1,6 +1,8 @@
 /*
  * phase3d.c
  *
+ *  Requires the phase3c in this tree (P3_frames, P3FrameClaim, the page operations); it
+ *  doesn't link against the reference phase3c library.
  */
 
 /***************
@@ -20,11 +22,36 @@ Pagers ignore busy frames when running the clock algorithm.
 
 A process's page table is a shared resource with the pager. The process changes its page table
 when it quits, and a pager changes the page table when it selects one of the process's pages
-in the clock algorithm. 
+in the replacement policy. 
 
-Normally the pagers would perform I/O concurrently, which means they would release the mutex
-while performing disk I/O. I made it simpler by having the pagers hold the mutex while they perform
-disk I/O.
+Pagers perform disk I/O concurrently: they hold no lock while a transfer is in progress.
+A page being written out is unmapped from its process before the transfer starts, so the process
+can't change it during the write, and its swap map entry is SLOT_PENDING until the write is done.
+A pager that needs such a page (or P3SwapFreeAll for its process) waits for the transfer to
+finish. The victim frame stays busy throughout, so the policy can't pick it again.
+
+Locks. Each shared resource has its own lock so that, e.g., a process can free its swap space
+while pagers evict and swap in pages of other processes.
+
+    clockMutex      victim selection: one pager at a time asks the policy for victims
+    swapMutex       the per-process swap maps and pendingIo counts (transfers in progress)
+    slotMutex       the bitmap of free swap slots
+    frameMutex      (phase3c) the pool of free frames and frame state transitions
+    policyLock      (policy.c) the policy's own state; held only inside its hooks
+    pffLock         (pff.c) per-process fault frequencies and frame targets
+    loadLock        (load.c) which processes load control has suspended
+
+A pager evicting a page counts the eviction in pendingIo of the page's process before it claims
+the frame (P3FrameClaim) and until it has unmapped the page, so P3SwapFreeAll, which waits for
+pendingIo to drop to zero, never races with an eviction of the same process.
+
+Lock ordering, shared with phase3c. A lock may only be acquired while holding locks above it:
+
+    1. mutex (phase3c), then a pager queue's lock
+    2. clockMutex
+    3. swapMutex
+    4. frameMutex (phase3c), slotMutex (never held together)
+    5. policyLock, pffLock, loadLock (no two held together)
 
 ***************/
 
@@ -55,9 +82,9 @@ static void debug3(char *fmt, ...)
     }
 }
 
-int initialized = FALSE;
-int numPages;
-int numFrames;
+static int initialized = FALSE;
+static int numPages;
+static int numFrames;
 
 // disk data
 int sectorSize; // bytes
@@ -65,31 +92,84 @@ int sectorsInTrack;
 int tracksInDisk;
 
 // semaphores
-int mutex;
+static int swapMutex;
+static int clockMutex;
+static int slotMutex;
 
 // helper functions for semaphores, makes code cleaner
-void P(int sid) {
+static void P(int sid) {
 	assert(P1_P(sid) == P1_SUCCESS);
 }
 
-void V(int sid) {
+static void V(int sid) {
 	assert(P1_V(sid) == P1_SUCCESS);
 }
 
-typedef struct f {
-	int busy;
-	int pid;
-	int page;
-	int track, sector, onDisk; // disk properties
-} Frame;
-
-Frame *allFrames;
 int maxFramesOnDisk;
 
-typedef struct p {
-	int pid, page;
-} DiskPage;
-DiskPage *pagesOnDisk;
+// Swap space is divided into page-sized slots. Each process has a map from its pages to the
+// slot that holds the page on disk (-1 if the page isn't on disk). The map is allocated the
+// first time one of the process's pages is written out. Free slots are tracked in a bitmap
+// (a set bit means the slot is free).
+//
+// A page keeps its slot after it is read back in, and its frame's dirty bit is cleared. As long
+// as the bit stays clear the copy on disk is current, so evicting the page costs no write. When
+// swap runs out, the slots of pages that are in memory are freed (SlotReclaim).
+static int *swapMaps[P1_MAXPROC];
+static unsigned int *freeSlots;
+static int numSlotWords;
+static int slotHint;    // word at which to start looking for a free slot
+
+#define SLOT_BITS   (8 * sizeof(unsigned int))
+
+#define SLOT_PENDING    -2  // swap map entry of a page that is being written out
+
+// number of transfers in progress for each process's pages
+static int pendingIo[P1_MAXPROC];
+
+// processes waiting for a transfer to finish wait on ioDone
+static int ioDone;
+static int ioWaiters;
+
+static int  SlotAlloc(void);
+static int  SlotAllocRun(int want, int *got);
+static void SlotFree(int slot);
+static int  SlotReclaim(void);
+static void SlotToDisk(int slot, int *track, int *first);
+static int  *SwapMap(int pid);
+static void WaitForIo(void);
+static void IoFinished(void);
+
+// Swap I/O goes through a page-aligned buffer owned by the calling process (a pager or the
+// page-out daemon). The disk driver runs in its own context, where the pager's P3FrameMap
+// mapping of the frame doesn't exist, so the frame can't be handed to it directly. The buffers
+// are allocated the first time a process does swap I/O and kept until P3SwapShutdown.
+static char *ioBuffers[P1_MAXPROC];
+
+static char *IoBuffer(void);
+
+int P3_swapOutCluster = 8;
+
+// number of pages P3SwapOut tries to write out together
+static int clusterSize;
+
+// size of the I/O buffers, in pages
+static int ioPages;
+
+// A frame P3SwapOut has claimed for replacement.
+typedef struct Victim {
+	int     frame;
+	PID     pid;
+	int     page;
+	int     access;     // access bits of the frame when it was unmapped
+	int     write;      // the page has to be written out
+	int     slot;       // slot the page was written to, -1 if none
+	int     failed;     // the page couldn't be written and is given back to its process
+} Victim;
+
+static int  SelectVictims(Victim *victims, int max);
+static int  ClaimVictim(int frame, int first, Victim *victim);
+static void Evict(Victim *victims, int count);
 
 /*
  *----------------------------------------------------------------------
@@ -114,20 +194,46 @@ P3SwapInit(int pages, int frames)
 		numFrames = frames;
 		initialized = TRUE;
 		assert(P2_DiskSize(P3_SWAP_DISK, &sectorSize, &sectorsInTrack, &tracksInDisk) == P1_SUCCESS);
-		allFrames = (Frame*) malloc(numFrames*sizeof(Frame));
-		for (int i = 0; i < numFrames; i++) {
-			allFrames[i].busy = TRUE;
-			allFrames[i].onDisk = FALSE;
-			allFrames[i].pid = -1;
-		}
-		result = P1_SemCreate("mutex", 1, &mutex);
+		result = P1_SemCreate("swapMutex", 1, &swapMutex);
+		assert(result == P1_SUCCESS);
+		result = P1_SemCreate("swapIoDone", 0, &ioDone);
+		assert(result == P1_SUCCESS);
+		result = P1_SemCreate("clockMutex", 1, &clockMutex);
+		assert(result == P1_SUCCESS);
+		result = P1_SemCreate("slotMutex", 1, &slotMutex);
+		assert(result == P1_SUCCESS);
+		result = P3PolicyInit(frames);
 		assert(result == P1_SUCCESS);
+		result = P3PffInit(frames);
+		assert(result == P1_SUCCESS);
+		result = P3LoadInit(frames);
+		assert(result == P1_SUCCESS);
+		ioWaiters = 0;
 	maxFramesOnDisk = tracksInDisk*sectorsInTrack*sectorSize/USLOSS_MmuPageSize();
-	pagesOnDisk = (DiskPage*) malloc(maxFramesOnDisk*sizeof(DiskPage));
+	numSlotWords = (maxFramesOnDisk + SLOT_BITS - 1) / SLOT_BITS;
+	freeSlots = (unsigned int *) calloc(numSlotWords, sizeof(unsigned int));
 	for (int i = 0; i < maxFramesOnDisk; i++) {
-		pagesOnDisk[i].page = -1;
-		pagesOnDisk[i].pid = -1;
+		freeSlots[i / SLOT_BITS] |= 1U << (i % SLOT_BITS);
+	}
+	slotHint = 0;
+	// clustering needs room for a few pages on each track and enough frames to spare
+	clusterSize = P3_swapOutCluster;
+	if (clusterSize > P3_MAX_SWAP_CLUSTER) clusterSize = P3_MAX_SWAP_CLUSTER;
+	if (clusterSize > numFrames / 8) clusterSize = numFrames / 8;
+	if (clusterSize > sectorsInTrack*sectorSize/USLOSS_MmuPageSize()) {
+		clusterSize = sectorsInTrack*sectorSize/USLOSS_MmuPageSize();
 	}
+	if (clusterSize < 1) clusterSize = 1;
+	ioPages = clusterSize;
+	if (P3_readAhead + 1 > ioPages) ioPages = P3_readAhead + 1;
+	if (ioPages > P3_MAX_SWAP_CLUSTER) ioPages = P3_MAX_SWAP_CLUSTER;
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		swapMaps[i] = NULL;
+		ioBuffers[i] = NULL;
+		pendingIo[i] = 0;
+	}
+	P3_vmStats.blocks = maxFramesOnDisk;
+	P3_vmStats.freeBlocks = maxFramesOnDisk;
     return result;
 }
 /*
@@ -148,11 +254,29 @@ P3SwapShutdown(void)
 {
     int result = P1_SUCCESS;
 		if (!initialized) return P3_NOT_INITIALIZED;
+		// load control's daemon may be paging a process out; stop it first
+		result = P3LoadShutdown();
+		assert(result == P1_SUCCESS);
     // clean things up
-		free(allFrames);
-		result = P1_SemFree(mutex);
+		result = P1_SemFree(swapMutex);
 		assert(result == P1_SUCCESS);
-	free(pagesOnDisk);
+		result = P1_SemFree(ioDone);
+		assert(result == P1_SUCCESS);
+		result = P1_SemFree(clockMutex);
+		assert(result == P1_SUCCESS);
+		result = P1_SemFree(slotMutex);
+		assert(result == P1_SUCCESS);
+		result = P3PolicyShutdown();
+		assert(result == P1_SUCCESS);
+		result = P3PffShutdown();
+		assert(result == P1_SUCCESS);
+	free(freeSlots);
+	for (int i = 0; i < P1_MAXPROC; i++) {
+		free(swapMaps[i]);
+		swapMaps[i] = NULL;
+		free(ioBuffers[i]);
+		ioBuffers[i] = NULL;
+	}
     return result;
 }
 
@@ -183,27 +307,36 @@ P3SwapFreeAll(int pid)
     V(mutex)
 
     *****************/
-	P(mutex);
+	P(swapMutex);
 	USLOSS_PTE *table;
 	result = P3PageTableGet(pid, &table);
+	if (result != P1_SUCCESS) {
+		V(swapMutex);
+		return result;
+	}
+	// let pagers finish writing out the process's pages
+	while (pendingIo[pid] > 0) {
+		WaitForIo();
+	}
 	if (table) {
 		for (int i = 0; i < numPages; i++) {
 			if (table[i].incore) {
-				table[i].incore = 0;
-				allFrames[table[i].frame].busy = TRUE;
-				for (int j = 0; j < maxFramesOnDisk; j++) {
-					if (pagesOnDisk[j].pid == pid && pagesOnDisk[j].page == i) {
-						pagesOnDisk[j].pid = -1;
-						pagesOnDisk[j].page = -1;
-					}
-				}
-				for (int j = 0; j < numFrames; j++) {
-					if (allFrames[j].pid == pid) allFrames[j].pid = -1;
-				}
+				// keep the clock away from the frame; P3FrameFreeAll returns it to the free pool
+				int rc = P3FrameClaim(table[i].frame, pid, NULL);
+				assert(rc == P1_SUCCESS);
 			}
 		}
 	}
-	V(mutex);
+	if (swapMaps[pid] != NULL) {
+		for (int i = 0; i < numPages; i++) {
+			if (swapMaps[pid][i] != -1) SlotFree(swapMaps[pid][i]);
+		}
+		free(swapMaps[pid]);
+		swapMaps[pid] = NULL;
+	}
+	V(swapMutex);
+	P3PffExit(pid);
+	P3LoadExit(pid);
     return result;
 }
 
@@ -212,12 +345,18 @@ P3SwapFreeAll(int pid)
  *
  * P3SwapOut --
  *
- * Uses the clock algorithm to select a frame to replace, writing the page that is in the frame out 
- * to swap if it is dirty. The page table of the page’s process is modified so that the page no 
- * longer maps to the frame. The frame that was selected is returned in *frame. 
+ * Uses the replacement policy (see policy.c) to select a frame to replace, writing the page
+ * that is in the frame out to swap if it is dirty. The page table of the page’s process is
+ * modified so that the page no longer maps to the frame. The frame that was selected is returned in *frame. 
+ *
+ * If the victim is dirty, other dirty pages the policy offers are evicted along with it and all of
+ * them are written to contiguous swap slots with one disk request (see P3_swapOutCluster).
+ * Their frames go to the free pool.
  *
  * Results:
  *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P3_OUT_OF_FRAMES:      no frame can be replaced right now (all are free or busy)
+ *   P3_OUT_OF_SWAP:        there is no swap space for the dirty page
  *   P1_SUCCESS:            success
  *
  *----------------------------------------------------------------------
@@ -225,7 +364,6 @@ P3SwapFreeAll(int pid)
 int
 P3SwapOut(int *frame) 
 {
-    int result = P1_SUCCESS;
 		if (!initialized) return P3_NOT_INITIALIZED;
 
     /*****************
@@ -254,80 +392,78 @@ P3SwapOut(int *frame)
     *frame = target
 
     *****************/
-	static int hand = -1;
-	int accessed;
-	int writeIndex = -1;
-	P(mutex);
-	while (1) {
-		hand = (hand + 1) % numFrames;
-		if (!allFrames[hand].busy) {
-			result = USLOSS_MmuGetAccess(hand, &accessed);
-			assert(result == USLOSS_MMU_OK);
-			if (accessed & 1) {
-				*frame = hand;
-				break;
-			}
-			else {
-				result = USLOSS_MmuSetAccess(hand, accessed & -2);
-				assert(result == USLOSS_MMU_OK);
-			}
-		}
+	Victim victims[P3_MAX_SWAP_CLUSTER];
+	int count = SelectVictims(victims, clusterSize);
+	if (count == 0) {
+		return P3_OUT_OF_FRAMES;
 	}
-	result = USLOSS_MmuGetAccess(*frame, &accessed);
-	assert(result == USLOSS_MMU_OK);
-	if ((accessed >> 1) & 1) {
-		void *page;
-		result = P3FrameMap(*frame, &page);
-		assert(result == P1_SUCCESS);
-		int i;
-		for (i = 0; i < maxFramesOnDisk; i++) {
-			if (pagesOnDisk[i].pid == -1) break;
-		}
-		int track = USLOSS_MmuPageSize()*i/(sectorsInTrack*sectorSize);
-		int first = (USLOSS_MmuPageSize()*i - track*sectorsInTrack*sectorSize)/sectorSize;
-		int sectors = USLOSS_MmuPageSize()/sectorSize;
-		char *tmpBuffer = (char*) malloc(USLOSS_MmuPageSize()*sizeof(char));
-		for (int i = 0; i < USLOSS_MmuPageSize(); i++) tmpBuffer[i] = ((char*) page)[i];
-		result = P2_DiskWrite(P3_SWAP_DISK, track, first, sectors, tmpBuffer);
-		free(tmpBuffer);
-		if (result != P1_SUCCESS) {
-			V(mutex);
-			return P3_OUT_OF_SWAP;
-		}
-		writeIndex = i;
+	Evict(victims, count);
 
-		result = P3FrameUnmap(*frame);
-		assert(result == P1_SUCCESS);
-		result = USLOSS_MmuSetAccess(*frame, accessed & (~(2)));
-		assert(result == USLOSS_MMU_OK);
-	}
-	USLOSS_PTE *table;
-	int pid = allFrames[*frame].pid;
-	result = P3PageTableGet(pid, &table);
-	assert(result == P1_SUCCESS);
-	if (table) {
-		for (int i = 0; i < numPages; i++) {
-			if (table[i].incore && table[i].frame == *frame) {
-				table[i].incore = 0;
-				if (writeIndex != -1) {
-					pagesOnDisk[writeIndex].pid = pid;
-					pagesOnDisk[writeIndex].page = i;
-				}
-				break;
-			}
+	// hand the first replaced frame to the caller and put the rest in the free pool
+	int target = -1;
+	for (int i = 0; i < count; i++) {
+		if (victims[i].failed) continue;
+		if (target == -1) {
+			target = victims[i].frame;
+		} else {
+			int rc = P3FrameRelease(victims[i].frame);
+			assert(rc == P1_SUCCESS);
 		}
 	}
+	if (target == -1) {
+		return P3_OUT_OF_SWAP;
+	}
+	*frame = target;
+    return P1_SUCCESS;
+}
 
-	allFrames[*frame].busy = TRUE;
-	V(mutex);
-    return result;
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapOutProcess --
+ *
+ *  Evicts every page the process has in memory, writing the dirty ones to swap in clusters,
+ *  and puts the frames in the free pool. Used by load control to take a suspended process's
+ *  frames away at once. Pages the pagers bring in for the process meanwhile stay in memory.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P1_SUCCESS:             success; the number of pages evicted is returned in *evicted
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapOutProcess(PID pid, int *evicted)
+{
+	if (!initialized) return P3_NOT_INITIALIZED;
+	if (pid < 0 || pid >= P1_MAXPROC) return P1_INVALID_PID;
+	*evicted = 0;
+	int frame = 0;
+	while (frame < numFrames) {
+		Victim victims[P3_MAX_SWAP_CLUSTER];
+		int count = 0;
+		for (; frame < numFrames && count < clusterSize; frame++) {
+			if (P3_frames[frame].pid != pid) continue;
+			if (ClaimVictim(frame, TRUE, &victims[count])) count++;
+		}
+		if (count == 0) break;
+		Evict(victims, count);
+		for (int i = 0; i < count; i++) {
+			if (victims[i].failed) continue;
+			int rc = P3FrameRelease(victims[i].frame);
+			assert(rc == P1_SUCCESS);
+			(*evicted)++;
+		}
+	}
+	return P1_SUCCESS;
 }
 /*
  *----------------------------------------------------------------------
  *
  * P3SwapIn --
  *
- *  Opposite of P3FrameMap. The frame is unmapped.
+ *  Reads a page from swap into a frame.
  *
  * Results:
  *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
@@ -342,12 +478,43 @@ P3SwapOut(int *frame)
  */
 int
 P3SwapIn(int pid, int page, int frame)
+{
+	int read;
+	return P3SwapInRun(pid, page, &frame, 1, &read);
+}
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapInRun --
+ *
+ *  Like P3SwapIn, reads the page into frames[0]. Pages page+1 .. page+count-1 are read into
+ *  frames[1] .. frames[count-1] by the same disk request, as long as they are not in memory
+ *  and sit in the swap slots that follow the page's slot on the same track. The number of
+ *  pages read is returned in *read; frames of pages that weren't read are left untouched.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid      
+ *   P1_INVALID_PAGE:        page is invalid         
+ *   P1_INVALID_FRAME:       a frame is invalid
+ *   P3_EMPTY_PAGE:          page is not in swap
+ *   P1_OUT_OF_SWAP:         there is no more swap space
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapInRun(int pid, int page, int *frames, int count, int *read)
 {
     int result = P1_SUCCESS;
 		if (!initialized) return P3_NOT_INITIALIZED;
 	if (pid < 0 || pid >= P1_MAXPROC) return P1_INVALID_PID;
 	if (page < 0 || page >= numPages) return P3_INVALID_PAGE;
-	if (frame < 0 || frame >= numFrames) return P3_INVALID_FRAME;
+	if (count < 1) return P3_INVALID_FRAME;
+	for (int i = 0; i < count; i++) {
+		if (frames[i] < 0 || frames[i] >= numFrames) return P3_INVALID_FRAME;
+	}
+	*read = 0;
 
     /*****************
 
@@ -364,41 +531,583 @@ P3SwapIn(int pid, int page, int frame)
     V(mutex)
 
     *****************/
-	P(mutex);
-	int isSpace = FALSE, diskIndex = -1;
-	for (int i = 0; i < maxFramesOnDisk; i++) {
-		if (pagesOnDisk[i].pid == pid && pagesOnDisk[i].page == page) diskIndex = i;
-		else if (pagesOnDisk[i].pid == -1) isSpace = TRUE;
+	P(swapMutex);
+	int diskIndex = (swapMaps[pid] != NULL) ? swapMaps[pid][page] : -1;
+	// the page may still be on its way out
+	while (diskIndex == SLOT_PENDING) {
+		WaitForIo();
+		diskIndex = swapMaps[pid][page];
 	}
 	if (diskIndex != -1) {
-		void *addr;
-		result = P3FrameMap(frame, &addr);
+		int pageSize = USLOSS_MmuPageSize();
+		int trackSize = sectorsInTrack*sectorSize;
+		int track, first;
+		SlotToDisk(diskIndex, &track, &first);
+		USLOSS_PTE *table;
+		result = P3PageTableGet(pid, &table);
 		assert(result == P1_SUCCESS);
+		int n = 1;
+		while (n < count && n < ioPages && page + n < numPages &&
+			   swapMaps[pid][page + n] == diskIndex + n &&
+			   (diskIndex + n + 1)*pageSize <= (track + 1)*trackSize &&
+			   (table == NULL || !table[page + n].incore)) {
+			n++;
+		}
+		pendingIo[pid]++;
+		V(swapMutex);
 
-		int track = USLOSS_MmuPageSize()*diskIndex/(sectorsInTrack*sectorSize);		
-		int first = (USLOSS_MmuPageSize()*diskIndex - track*sectorsInTrack*sectorSize)/sectorSize;
-		int sectors = USLOSS_MmuPageSize()/sectorSize;
-		char *tmpBuffer = (char*) malloc(USLOSS_MmuPageSize()*sizeof(char));
-		
-		result = P2_DiskRead(P3_SWAP_DISK, track, first, sectors, tmpBuffer);
-		if (result != P1_SUCCESS) {
-			V(mutex);
-			return P3_OUT_OF_SWAP;
+		char *buffer = IoBuffer();
+		result = P2_DiskRead(P3_SWAP_DISK, track, first, n*pageSize/sectorSize, buffer);
+		if (result == P1_SUCCESS) {
+			for (int i = 0; i < n; i++) {
+				void *addr;
+				result = P3FrameMap(frames[i], &addr);
+				assert(result == P1_SUCCESS);
+				P3PageCopy(addr, buffer + i*pageSize);
+				result = P3FrameUnmap(frames[i]);
+				assert(result == P1_SUCCESS);
+				// the frame matches the copy in swap until the page is written to
+				int access;
+				result = USLOSS_MmuGetAccess(frames[i], &access);
+				assert(result == USLOSS_MMU_OK);
+				result = USLOSS_MmuSetAccess(frames[i], access & ~USLOSS_MMU_DIRTY);
+				assert(result == USLOSS_MMU_OK);
+			}
+		} else {
+			result = P3_OUT_OF_SWAP;
 		}
-		for (int i = 0; i < USLOSS_MmuPageSize(); i++) ((char*) addr)[i] = tmpBuffer[i];
-		free(tmpBuffer);
 
-		result = P3FrameUnmap(frame);
-		assert(result == P1_SUCCESS);
-		pagesOnDisk[diskIndex].pid = -1;
-		pagesOnDisk[diskIndex].page = -1;
+		P(swapMutex);
+		if (result == P1_SUCCESS) {
+			// the slots stay allocated, so the pages can be dropped if they are evicted clean
+			*read = n;
+			P3_vmStats.pageIns++;
+		}
+		pendingIo[pid]--;
+		IoFinished();
 	} else {
-		if (!isSpace) result = P3_OUT_OF_SWAP;
+		if (P3_vmStats.freeBlocks == 0) SlotReclaim();
+		if (P3_vmStats.freeBlocks == 0) result = P3_OUT_OF_SWAP;
 		else result = P3_EMPTY_PAGE;
 	}
-	allFrames[frame].busy = FALSE;
-	allFrames[frame].pid = pid;
-	allFrames[frame].page = page;
-	V(mutex);
+	V(swapMutex);
     return result;
 }
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapProbe --
+ *
+ *  Tells whether a page has a copy in swap (or is on its way there) without reading it.
+ *  Returns what P3SwapIn would. If track isn't NULL, the track that holds the copy is
+ *  returned in *track (-1 if there is no copy on disk yet).
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid      
+ *   P1_INVALID_PAGE:        page is invalid         
+ *   P3_EMPTY_PAGE:          page is not in swap
+ *   P1_OUT_OF_SWAP:         page is not in swap and there is no more swap space
+ *   P1_SUCCESS:             page is in swap
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapProbe(int pid, int page, int *track)
+{
+	if (!initialized) return P3_NOT_INITIALIZED;
+	if (pid < 0 || pid >= P1_MAXPROC) return P1_INVALID_PID;
+	if (page < 0 || page >= numPages) return P3_INVALID_PAGE;
+	P(swapMutex);
+	int result = P1_SUCCESS;
+	int slot = (swapMaps[pid] != NULL) ? swapMaps[pid][page] : -1;
+	if (slot == -1) {
+		if (P3_vmStats.freeBlocks == 0) SlotReclaim();
+		result = (P3_vmStats.freeBlocks == 0) ? P3_OUT_OF_SWAP : P3_EMPTY_PAGE;
+	}
+	V(swapMutex);
+	if (track != NULL) {
+		int first;
+		*track = -1;
+		if (slot >= 0) SlotToDisk(slot, track, &first);
+	}
+	return result;
+}
+/*
+ *----------------------------------------------------------------------
+ *
+ * SelectVictims --
+ *
+ *  Asks the replacement policy for frames to replace and claims them (ClaimVictim). A clean
+ *  victim is replaced on its own; a dirty one is joined by up to max-1 other dirty pages the
+ *  policy offers next, so they can be written out together. Each victim counts as a pending
+ *  transfer for its process until P3SwapOut is done with it.
+ *
+ *  Candidates are ranked by their process's fault frequency (P3PffRank). The first victim
+ *  comes from the best rank any process has, if the policy offers one within a sweep's worth
+ *  of candidates; otherwise it is the best-ranked candidate offered. Companions must rank no
+ *  worse than the first victim.
+ *
+ * Results:
+ *   The number of victims in victims[], 0 if no frame can be replaced.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+SelectVictims(Victim *victims, int max)
+{
+	int count = 0;
+	int fallback = -1;      // best-ranked candidate passed over for the first victim
+	int fallbackRank = 0;
+	int rank = 0;           // rank of the first victim
+	P(clockMutex);
+	int best = P3PffUpdate();
+	// the policy may offer frames we can't use; give up after a sweep's worth
+	for (int n = 0; n < numFrames && count < max; n++) {
+		int frame = P3_policy->select();
+		if (frame == -1) break;
+		PID pid = P3_frames[frame].pid;
+		if (P3_frames[frame].state != P3_FRAME_INUSE || pid < 0) continue;
+		int candidateRank = P3PffRank(pid);
+		if (count == 0 && candidateRank > best) {
+			if (fallback == -1 || candidateRank < fallbackRank) {
+				fallback = frame;
+				fallbackRank = candidateRank;
+			}
+			continue;
+		}
+		if (count > 0 && candidateRank > rank) continue;
+		if (!ClaimVictim(frame, count == 0, &victims[count])) continue;
+		count++;
+		if (count == 1) {
+			rank = candidateRank;
+			if (!(victims[0].access & USLOSS_MMU_DIRTY)) break;
+		}
+	}
+	if (count == 0 && fallback != -1 && ClaimVictim(fallback, TRUE, &victims[0])) {
+		count++;
+	}
+	V(clockMutex);
+	return count;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Evict --
+ *
+ *  Takes claimed victims out of their processes' page tables and writes the ones that need
+ *  it to swap. A victim that couldn't be written is given back to its process and marked
+ *  failed; the frames of the others are left claimed for the caller.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+Evict(Victim *victims, int count)
+{
+	int result;
+
+	// Unmap the pages so their processes can't change them while they are written out. Each
+	// PTE and swap map entry change together under swapMutex, so a fault on a page being
+	// written finds its slot pending, never the old slot or none. A clean page whose copy in
+	// swap is still valid is simply dropped. A dirty page's old copy is stale; it is freed and
+	// the page is written to a new slot.
+	int writes = 0;
+	P(swapMutex);
+	for (int i = 0; i < count; i++) {
+		Victim *v = &victims[i];
+		USLOSS_PTE *table;
+		result = P3PageTableGet(v->pid, &table);
+		assert(result == P1_SUCCESS);
+		assert(table != NULL && table[v->page].incore && table[v->page].frame == v->frame);
+		table[v->page].incore = 0;
+		P3_frames[v->frame].pid = -1;
+		P3_frames[v->frame].page = -1;
+		P3_policy->unmapped(v->frame);
+		result = USLOSS_MmuGetAccess(v->frame, &v->access);
+		assert(result == USLOSS_MMU_OK);
+		int slot = (swapMaps[v->pid] != NULL) ? swapMaps[v->pid][v->page] : -1;
+		if ((v->access & USLOSS_MMU_DIRTY) || slot == -1) {
+			if (slot != -1) SlotFree(slot);
+			SwapMap(v->pid)[v->page] = SLOT_PENDING;
+			v->write = TRUE;
+			writes++;
+		}
+	}
+	V(swapMutex);
+
+	// copy the pages to be written into the I/O buffer back to back
+	char *buffer = IoBuffer();
+	int order[P3_MAX_SWAP_CLUSTER];    // victims in buffer order
+	int copied = 0;
+	int pageSize = USLOSS_MmuPageSize();
+	for (int i = 0; i < count && writes > 0; i++) {
+		Victim *v = &victims[i];
+		if (!v->write) continue;
+		void *addr;
+		result = P3FrameMap(v->frame, &addr);
+		assert(result == P1_SUCCESS);
+		P3PageCopy(buffer + copied*pageSize, addr);
+		order[copied++] = i;
+		result = P3FrameUnmap(v->frame);
+		assert(result == P1_SUCCESS);
+		result = USLOSS_MmuSetAccess(v->frame, v->access & ~USLOSS_MMU_DIRTY);
+		assert(result == USLOSS_MMU_OK);
+	}
+
+	// write the pages to runs of contiguous slots, one disk request per run
+	int written = 0;
+	while (written < copied) {
+		int run;
+		int slot = SlotAllocRun(copied - written, &run);
+		if (slot == -1) {
+			// swap is full; take back the slots cached for pages that are in memory
+			P(swapMutex);
+			int reclaimed = SlotReclaim();
+			V(swapMutex);
+			if (reclaimed > 0) {
+				slot = SlotAllocRun(copied - written, &run);
+			}
+		}
+		if (slot == -1) {
+			break;
+		}
+		int track, first;
+		SlotToDisk(slot, &track, &first);
+		result = P2_DiskWrite(P3_SWAP_DISK, track, first, run*pageSize/sectorSize,
+							  buffer + written*pageSize);
+		if (result != P1_SUCCESS) {
+			for (int i = 0; i < run; i++) {
+				SlotFree(slot + i);
+			}
+			break;
+		}
+		for (int i = 0; i < run; i++) {
+			victims[order[written + i]].slot = slot + i;
+		}
+		written += run;
+	}
+	for (int i = written; i < copied; i++) {
+		victims[order[i]].failed = TRUE;
+	}
+
+	P(swapMutex);
+	for (int i = 0; i < count; i++) {
+		Victim *v = &victims[i];
+		if (v->failed) {
+			// the page is still in the frame; give it back to its process
+			USLOSS_PTE *table;
+			int rc = P3PageTableGet(v->pid, &table);
+			assert(rc == P1_SUCCESS);
+			table[v->page].incore = 1;
+			rc = USLOSS_MmuSetAccess(v->frame, v->access);
+			assert(rc == USLOSS_MMU_OK);
+			P3_policy->mapped(v->frame);
+			rc = P3FrameUnclaim(v->frame, v->pid, v->page);
+			assert(rc == P1_SUCCESS);
+		}
+		if (v->write) {
+			swapMaps[v->pid][v->page] = v->slot;
+		}
+		pendingIo[v->pid]--;
+	}
+	if (written > 0) {
+		P3_vmStats.pageOuts++;
+	}
+	IoFinished();
+	V(swapMutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ClaimVictim --
+ *
+ *  Claims a frame in use for replacement (P3FrameClaim) and fills in *victim. Companions
+ *  (first == FALSE) must be dirty.
+ *
+ * Results:
+ *   TRUE if the frame was claimed.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+ClaimVictim(int frame, int first, Victim *victim)
+{
+	PID pid = P3_frames[frame].pid;
+	if (P3_frames[frame].state != P3_FRAME_INUSE || pid < 0) return FALSE;
+	int accessed;
+	int rc = USLOSS_MmuGetAccess(frame, &accessed);
+	assert(rc == USLOSS_MMU_OK);
+	if (!first && !(accessed & USLOSS_MMU_DIRTY)) return FALSE;
+	// hold off P3SwapFreeAll for the process until the page is unmapped
+	P(swapMutex);
+	pendingIo[pid]++;
+	V(swapMutex);
+	int page;
+	if (P3FrameClaim(frame, pid, &page) != P1_SUCCESS) {
+		P(swapMutex);
+		pendingIo[pid]--;
+		IoFinished();
+		V(swapMutex);
+		return FALSE;
+	}
+	victim->frame = frame;
+	victim->pid = pid;
+	victim->page = page;
+	victim->access = accessed;
+	victim->write = FALSE;
+	victim->slot = -1;
+	victim->failed = FALSE;
+	return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SlotAllocRun --
+ *
+ *  Allocates up to "want" free swap slots that are contiguous and on the same track, so
+ *  they can be written with one disk request. The longest run found is returned if there
+ *  is no run of "want" slots.
+ *
+ * Results:
+ *   The first slot of the run and its length in *got, or -1 if swap is full.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+SlotAllocRun(int want, int *got)
+{
+	if (want == 1) {
+		*got = 1;
+		return SlotAlloc();
+	}
+	int pageSize = USLOSS_MmuPageSize();
+	int trackSize = sectorsInTrack*sectorSize;
+	int best = -1;
+	int bestLen = 0;
+	int start = -1;
+	int len = 0;
+	P(slotMutex);
+	for (int n = 0; n < maxFramesOnDisk && bestLen < want; n++) {
+		int slot = (slotHint * SLOT_BITS + n) % maxFramesOnDisk;
+		if (slot == 0) len = 0;
+		if (slot % SLOT_BITS == 0 && freeSlots[slot / SLOT_BITS] == 0) {
+			// skip a word of used slots
+			int skip = SLOT_BITS;
+			if (slot + skip > maxFramesOnDisk) skip = maxFramesOnDisk - slot;
+			n += skip - 1;
+			len = 0;
+			continue;
+		}
+		if ((freeSlots[slot / SLOT_BITS] & (1U << (slot % SLOT_BITS))) == 0) {
+			len = 0;
+			continue;
+		}
+		// a run can't continue onto the next track
+		if (len > 0 && (slot + 1)*pageSize > (start*pageSize/trackSize + 1)*trackSize) {
+			len = 0;
+		}
+		if (len == 0) start = slot;
+		len++;
+		if (len > bestLen) {
+			best = start;
+			bestLen = len;
+		}
+	}
+	for (int i = 0; i < bestLen; i++) {
+		freeSlots[(best + i) / SLOT_BITS] &= ~(1U << ((best + i) % SLOT_BITS));
+	}
+	if (bestLen > 0) {
+		slotHint = best / SLOT_BITS;
+		P3_vmStats.freeBlocks -= bestLen;
+	}
+	V(slotMutex);
+	*got = bestLen;
+	return best;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SlotAlloc --
+ *
+ *  Allocates a free swap slot.
+ *
+ * Results:
+ *   The slot number, or -1 if swap is full.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+SlotAlloc(void)
+{
+	int slot = -1;
+	P(slotMutex);
+	for (int n = 0; n < numSlotWords; n++) {
+		int w = (slotHint + n) % numSlotWords;
+		if (freeSlots[w] != 0) {
+			int bit = __builtin_ffs(freeSlots[w]) - 1;
+			freeSlots[w] &= ~(1U << bit);
+			slotHint = w;
+			P3_vmStats.freeBlocks--;
+			slot = w * SLOT_BITS + bit;
+			break;
+		}
+	}
+	V(slotMutex);
+	return slot;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SlotFree --
+ *
+ *  Returns a swap slot to the free bitmap.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+SlotFree(int slot)
+{
+	assert(slot >= 0 && slot < maxFramesOnDisk);
+	P(slotMutex);
+	assert((freeSlots[slot / SLOT_BITS] & (1U << (slot % SLOT_BITS))) == 0);
+	freeSlots[slot / SLOT_BITS] |= 1U << (slot % SLOT_BITS);
+	P3_vmStats.freeBlocks++;
+	V(slotMutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SlotReclaim --
+ *
+ *  Frees the slots kept for pages that are in memory. Their copies in swap only save a write
+ *  when the pages are evicted, so they are given up when swap runs out. A page that loses its
+ *  slot is written to a new one when it is evicted. Must be called with swapMutex held.
+ *
+ * Results:
+ *   The number of slots freed.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+SlotReclaim(void)
+{
+	int freed = 0;
+	for (int frame = 0; frame < numFrames; frame++) {
+		PID pid = P3_frames[frame].pid;
+		int page = P3_frames[frame].page;
+		if (P3_frames[frame].state != P3_FRAME_INUSE || pid < 0 || page < 0) continue;
+		if (swapMaps[pid] == NULL || swapMaps[pid][page] < 0) continue;
+		// only a page that is mapped is done being read in, and isn't being written out
+		USLOSS_PTE *table;
+		int rc = P3PageTableGet(pid, &table);
+		if (rc != P1_SUCCESS || table == NULL) continue;
+		if (!table[page].incore || table[page].frame != frame) continue;
+		SlotFree(swapMaps[pid][page]);
+		swapMaps[pid][page] = -1;
+		freed++;
+	}
+	return freed;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SlotToDisk --
+ *
+ *  Converts a swap slot into the track and first sector that hold it.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+SlotToDisk(int slot, int *track, int *first)
+{
+	int offset = slot * USLOSS_MmuPageSize();
+	*track = offset / (sectorsInTrack*sectorSize);
+	*first = (offset - *track*sectorsInTrack*sectorSize)/sectorSize;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IoBuffer --
+ *
+ *  Returns the calling process's swap I/O buffer, allocating it if necessary.
+ *
+ *----------------------------------------------------------------------
+ */
+static char *
+IoBuffer(void)
+{
+	int pid = P1_GetPid();
+	if (ioBuffers[pid] == NULL) {
+		void *buffer;
+		int rc = posix_memalign(&buffer, USLOSS_MmuPageSize(), ioPages*USLOSS_MmuPageSize());
+		assert(rc == 0);
+		ioBuffers[pid] = (char *) buffer;
+	}
+	return ioBuffers[pid];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SwapMap --
+ *
+ *  Returns a process's swap map, allocating it if necessary. Must be called with
+ *  swapMutex held.
+ *
+ *----------------------------------------------------------------------
+ */
+static int *
+SwapMap(int pid)
+{
+	if (swapMaps[pid] == NULL) {
+		swapMaps[pid] = (int *) malloc(numPages*sizeof(int));
+		for (int i = 0; i < numPages; i++) swapMaps[pid][i] = -1;
+	}
+	return swapMaps[pid];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WaitForIo --
+ *
+ *  Waits for some transfer to finish. Must be called with swapMutex held; swapMutex is
+ *  released while waiting and held again on return, so the caller must recheck whatever
+ *  it was waiting for.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+WaitForIo(void)
+{
+	ioWaiters++;
+	V(swapMutex);
+	P(ioDone);
+	P(swapMutex);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IoFinished --
+ *
+ *  Wakes up everyone waiting for a transfer to finish. Must be called with swapMutex held.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+IoFinished(void)
+{
+	while (ioWaiters > 0) {
+		ioWaiters--;
+		V(ioDone);
+	}
+}
@@ -0,0 +1,634 @@
+/*
+ * policy.c
+ *
+ *  Page replacement policies for P3SwapOut. The policy is chosen by P3_replacementPolicy
+ *  when P3SwapInit runs. P3SwapOut asks it for victims (select); the pagers tell it when a
+ *  frame starts holding a page (mapped) and when it stops (unmapped); and it hears about
+ *  every reference bit that is found set and cleared (referenced).
+ *
+ *  All policies share policyLock. select, mapped and unmapped take it, as does the aging
+ *  policy's daemon; referenced is called with it held. Nothing else is acquired while it is
+ *  held.
+ */
+
+#include <assert.h>
+#include <phase1.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phase3.h"
+#include "phase3Int.h"
+
+int P3_replacementPolicy = P3_POLICY_CLOCK;
+
+static int numFrames;
+static SID policyLock;
+
+static void P(int sid) {
+	assert(P1_P(sid) == P1_SUCCESS);
+}
+
+static void V(int sid) {
+	assert(P1_V(sid) == P1_SUCCESS);
+}
+
+static int  TestRef(int frame);
+static int  Now(void);
+
+// Frame lists used by the FIFO and LRU policies: frames linked in order, oldest first.
+static int *listNext;
+static int *listPrev;
+static int *listed;
+static int listHead;
+static int listTail;
+
+static void ListInit(void);
+static void ListFree(void);
+static void ListRemove(int frame);
+static void ListAppend(int frame);
+
+/*
+ * CLOCK: one hand sweeps the frames, clearing reference bits, and stops at the first frame
+ * in use whose bit was already clear.
+ */
+
+static int clockHand;
+
+static void
+ClockInit(int frames)
+{
+	clockHand = -1;
+}
+
+static void
+NoShutdown(void)
+{
+}
+
+static int
+ClockSelect(void)
+{
+	int victim = -1;
+	P(policyLock);
+	// two sweeps are enough to find a victim if any frame is in use
+	for (int n = 0; n < 2*numFrames && victim == -1; n++) {
+		clockHand = (clockHand + 1) % numFrames;
+		if (P3_frames[clockHand].state != P3_FRAME_INUSE) continue;
+		if (!TestRef(clockHand)) victim = clockHand;
+	}
+	V(policyLock);
+	return victim;
+}
+
+static void
+NoFrameHook(int frame)
+{
+}
+
+/*
+ * FIFO with second chance: frames are queued in the order they were mapped. The frame at the
+ * head is the victim unless it has been referenced, in which case it goes to the tail. A
+ * frame that is offered as a victim also goes to the tail, so a candidate P3SwapOut passes
+ * over isn't offered again right away.
+ */
+
+static void
+FifoInit(int frames)
+{
+	ListInit();
+}
+
+static void
+FifoShutdown(void)
+{
+	ListFree();
+}
+
+static int
+FifoSelect(void)
+{
+	int victim = -1;
+	P(policyLock);
+	for (int n = 0; n < 2*numFrames && victim == -1 && listHead != -1; n++) {
+		int frame = listHead;
+		ListRemove(frame);
+		ListAppend(frame);
+		if (P3_frames[frame].state != P3_FRAME_INUSE) continue;
+		if (!TestRef(frame)) victim = frame;
+	}
+	V(policyLock);
+	return victim;
+}
+
+static void
+ListMapped(int frame)
+{
+	P(policyLock);
+	ListRemove(frame);
+	ListAppend(frame);
+	V(policyLock);
+}
+
+static void
+ListUnmapped(int frame)
+{
+	P(policyLock);
+	ListRemove(frame);
+	V(policyLock);
+}
+
+/*
+ * Two-handed clock: the front hand clears reference bits and the back hand, a fixed number
+ * of frames behind it, takes the first frame in use that hasn't been referenced since the
+ * front hand passed. The gap between the hands is how long a page has to prove it is in use.
+ */
+
+static int frontHand;
+static int handSpread;
+
+static void
+Clock2Init(int frames)
+{
+	frontHand = -1;
+	handSpread = frames / 4;
+	if (handSpread < 1) handSpread = 1;
+}
+
+static int
+Clock2Select(void)
+{
+	int victim = -1;
+	P(policyLock);
+	for (int n = 0; n < 2*numFrames && victim == -1; n++) {
+		frontHand = (frontHand + 1) % numFrames;
+		if (P3_frames[frontHand].state == P3_FRAME_INUSE) {
+			(void) TestRef(frontHand);
+		}
+		int back = (frontHand + numFrames - handSpread) % numFrames;
+		if (P3_frames[back].state != P3_FRAME_INUSE) continue;
+		int access;
+		int rc = USLOSS_MmuGetAccess(back, &access);
+		assert(rc == USLOSS_MMU_OK);
+		if (!(access & USLOSS_MMU_REF)) victim = back;
+	}
+	V(policyLock);
+	return victim;
+}
+
+/*
+ * LRU: frames are kept in the order they were last seen referenced, least recently used
+ * first. The hardware only has reference bits, so "exact" means exact with respect to the
+ * references observed: select samples and clears every frame's bit before choosing, and any
+ * other sampling (TestRef) refines the order in between. This is meant as a yardstick
+ * for the other policies, as select costs a pass over all frames.
+ */
+
+static int
+LruSelect(void)
+{
+	int victim = -1;
+	P(policyLock);
+	for (int frame = 0; frame < numFrames; frame++) {
+		if (P3_frames[frame].state == P3_FRAME_INUSE) {
+			(void) TestRef(frame);
+		}
+	}
+	for (int frame = listHead; frame != -1; frame = listNext[frame]) {
+		if (P3_frames[frame].state == P3_FRAME_INUSE) {
+			victim = frame;
+			break;
+		}
+	}
+	if (victim != -1) {
+		// don't offer the same frame again if P3SwapOut passes over it
+		ListRemove(victim);
+		ListAppend(victim);
+	}
+	V(policyLock);
+	return victim;
+}
+
+static void
+LruReferenced(int frame)
+{
+	if (listed[frame]) {
+		ListRemove(frame);
+		ListAppend(frame);
+	}
+}
+
+/*
+ * WSClock: a page is in its process's working set if it has been seen referenced within the
+ * last P3_workingSetWindow microseconds. Each frame remembers when its reference bit was last
+ * found set (or when it was mapped). The hand sweeps the frames once, clearing reference bits;
+ * the first clean page outside the working set is the victim. Failing that, the first dirty
+ * page outside the working set, and failing that the page that had gone unreferenced longest
+ * when the sweep started, even if it has been referenced since.
+ */
+
+int P3_workingSetWindow = 100000;
+
+static int *lastUse;
+static int wsHand;
+
+static void
+WsInit(int frames)
+{
+	lastUse = (int *) calloc(frames, sizeof(int));
+	wsHand = -1;
+}
+
+static void
+WsShutdown(void)
+{
+	free(lastUse);
+}
+
+static int
+WsSelect(void)
+{
+	int victim = -1;
+	int dirty = -1;     // first dirty page outside the working set
+	int oldest = -1;    // page unreferenced the longest before this sweep
+	int oldestUse = 0;
+	P(policyLock);
+	int now = Now();
+	for (int n = 0; n < numFrames && victim == -1; n++) {
+		wsHand = (wsHand + 1) % numFrames;
+		if (P3_frames[wsHand].state != P3_FRAME_INUSE) continue;
+		// a referenced page can still be the oldest, so there is a victim even if every page
+		// has been referenced since the last sweep
+		if (oldest == -1 || lastUse[wsHand] - oldestUse < 0) {
+			oldest = wsHand;
+			oldestUse = lastUse[wsHand];
+		}
+		if (TestRef(wsHand)) continue;
+		if (now - lastUse[wsHand] <= P3_workingSetWindow) continue;
+		int access;
+		int rc = USLOSS_MmuGetAccess(wsHand, &access);
+		assert(rc == USLOSS_MMU_OK);
+		if (!(access & USLOSS_MMU_DIRTY)) {
+			victim = wsHand;
+		} else if (dirty == -1) {
+			dirty = wsHand;
+		}
+	}
+	if (victim == -1) victim = (dirty != -1) ? dirty : oldest;
+	V(policyLock);
+	return victim;
+}
+
+static void
+WsMapped(int frame)
+{
+	P(policyLock);
+	lastUse[frame] = Now();
+	V(policyLock);
+}
+
+static void
+WsReferenced(int frame)
+{
+	lastUse[frame] = Now();
+}
+
+/*
+ * Aging: a daemon wakes up every P3_agingInterval seconds and shifts each frame's reference bit
+ * into the top of an 8-bit history, clearing the bit. Victims are taken coldest first from an
+ * order built in one pass over the frames without touching any reference bits; a bit that is
+ * set but not yet sampled counts as more recent than the whole history. The order is rebuilt
+ * after the daemon samples the bits or when it runs out, and a frame referenced since the
+ * pass is skipped.
+ */
+
+#define AGING_PRIORITY  (P3_PAGER_PRIORITY + 1)
+#define AGE_RECENT      0x80
+#define AGE_HISTORIES   (AGE_RECENT << 2)   // histories including an unsampled reference bit
+
+int P3_agingInterval = 1;
+
+static unsigned char *age;
+static int agingHand;
+static int *agingOrder;     // frames in use when the order was built, coldest first
+static int *agingSorted;    // each frame's history when the order was built, -1 if not in use
+static int agingCount;      // # of frames in agingOrder
+static int agingNext;       // next frame in agingOrder to return
+static P3Ticker *agingTicker;
+static SID agingDone;
+
+static int  AgingDaemon(void *arg);
+static int  AgingHistory(int frame);
+static void AgingSort(void);
+
+static void
+AgingInit(int frames)
+{
+	age = (unsigned char *) calloc(frames, sizeof(unsigned char));
+	agingOrder = (int *) malloc(frames*sizeof(int));
+	agingSorted = (int *) malloc(frames*sizeof(int));
+	agingHand = -1;
+	agingCount = 0;
+	agingNext = 0;
+	int rc = P1_SemCreate("agingDone", 0, &agingDone);
+	assert(rc == P1_SUCCESS);
+	agingTicker = P3TickerStart("aging", &P3_agingInterval, AGING_PRIORITY);
+	int pid;
+	rc = P1_Fork("aging", AgingDaemon, NULL, USLOSS_MIN_STACK, AGING_PRIORITY, 0, &pid);
+	assert(rc == P1_SUCCESS);
+}
+
+static void
+AgingShutdown(void)
+{
+	P3TickerStop(agingTicker);
+	P(agingDone);
+	int rc = P1_SemFree(agingDone);
+	assert(rc == P1_SUCCESS);
+	free(agingOrder);
+	free(agingSorted);
+	free(age);
+}
+
+static int
+AgingHistory(int frame)
+{
+	int access;
+	int rc = USLOSS_MmuGetAccess(frame, &access);
+	assert(rc == USLOSS_MMU_OK);
+	return age[frame] | ((access & USLOSS_MMU_REF) ? AGE_RECENT << 1 : 0);
+}
+
+static void
+AgingSort(void)
+{
+	static int count[AGE_HISTORIES];
+	int *history = agingSorted;
+	memset(count, 0, sizeof(count));
+	// start after the last victim so frames with equal histories take turns
+	int first = agingHand + 1;
+	for (int n = 0; n < numFrames; n++) {
+		int frame = (first + n) % numFrames;
+		history[frame] = -1;
+		if (P3_frames[frame].state != P3_FRAME_INUSE) continue;
+		history[frame] = AgingHistory(frame);
+		count[history[frame]]++;
+	}
+	// counting sort: count[h] becomes where the first frame with history h goes
+	agingCount = 0;
+	for (int h = 0; h < AGE_HISTORIES; h++) {
+		int n = count[h];
+		count[h] = agingCount;
+		agingCount += n;
+	}
+	for (int n = 0; n < numFrames; n++) {
+		int frame = (first + n) % numFrames;
+		if (history[frame] != -1) agingOrder[count[history[frame]]++] = frame;
+	}
+	agingNext = 0;
+}
+
+static int
+AgingSelect(void)
+{
+	int victim = -1;
+	P(policyLock);
+	int sorted = FALSE;
+	while (victim == -1) {
+		if (agingNext >= agingCount) {
+			// nothing left in the order; a fresh one has a victim if any frame is in use
+			if (sorted) break;
+			AgingSort();
+			sorted = TRUE;
+		}
+		while (agingNext < agingCount && victim == -1) {
+			int frame = agingOrder[agingNext++];
+			if (P3_frames[frame].state != P3_FRAME_INUSE) continue;
+			// a frame referenced since the order was built is no longer where it was
+			int referenced = AGE_RECENT << 1;
+			if ((AgingHistory(frame) & referenced) && !(agingSorted[frame] & referenced)) continue;
+			victim = frame;
+		}
+	}
+	if (victim != -1) agingHand = victim;
+	V(policyLock);
+	return victim;
+}
+
+static void
+AgingMapped(int frame)
+{
+	P(policyLock);
+	age[frame] = AGE_RECENT;
+	V(policyLock);
+}
+
+static void
+AgingUnmapped(int frame)
+{
+	P(policyLock);
+	age[frame] = 0;
+	V(policyLock);
+}
+
+static void
+AgingReferenced(int frame)
+{
+	age[frame] |= AGE_RECENT;
+}
+
+static P3Policy policies[] = {
+	[P3_POLICY_CLOCK]  = {"clock", ClockInit, NoShutdown, ClockSelect, NoFrameHook, NoFrameHook,
+						  NoFrameHook},
+	[P3_POLICY_FIFO]   = {"fifo", FifoInit, FifoShutdown, FifoSelect, ListMapped, ListUnmapped,
+						  NoFrameHook},
+	[P3_POLICY_CLOCK2] = {"clock2", Clock2Init, NoShutdown, Clock2Select, NoFrameHook,
+						  NoFrameHook, NoFrameHook},
+	[P3_POLICY_LRU]    = {"lru", FifoInit, FifoShutdown, LruSelect, ListMapped, ListUnmapped,
+						  LruReferenced},
+	[P3_POLICY_WSCLOCK] = {"wsclock", WsInit, WsShutdown, WsSelect, WsMapped, NoFrameHook,
+						  WsReferenced},
+	[P3_POLICY_AGING]  = {"aging", AgingInit, AgingShutdown, AgingSelect, AgingMapped,
+						  AgingUnmapped, AgingReferenced},
+};
+
+#define NUM_POLICIES    ((int) (sizeof(policies) / sizeof(policies[0])))
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PolicyInit --
+ *
+ *  Sets up the replacement policy chosen by P3_replacementPolicy. An unknown policy falls
+ *  back to CLOCK.
+ *
+ * Results:
+ *   P3_ALREADY_INITIALIZED:    this function has already been called
+ *   P1_SUCCESS:                success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3PolicyInit(int frames)
+{
+	if (P3_policy != NULL) return P3_ALREADY_INITIALIZED;
+	numFrames = frames;
+	int rc = P1_SemCreate("policyLock", 1, &policyLock);
+	assert(rc == P1_SUCCESS);
+	int which = P3_replacementPolicy;
+	if (which < 0 || which >= NUM_POLICIES) which = P3_POLICY_CLOCK;
+	P3_policy = &policies[which];
+	P3_policy->init(frames);
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PolicyShutdown --
+ *
+ *  Cleans up the replacement policy.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3PolicyInit has not been called
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3PolicyShutdown(void)
+{
+	if (P3_policy == NULL) return P3_NOT_INITIALIZED;
+	P3_policy->shutdown();
+	P3_policy = NULL;
+	int rc = P1_SemFree(policyLock);
+	assert(rc == P1_SUCCESS);
+	return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TestRef --
+ *
+ *  Samples a frame's reference bit for the policy: if it is set it is cleared and the
+ *  policy's referenced hook is called. Must be called with policyLock held.
+ *
+ * Results:
+ *   TRUE if the frame had been referenced.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+TestRef(int frame)
+{
+	int access;
+	int rc = USLOSS_MmuGetAccess(frame, &access);
+	assert(rc == USLOSS_MMU_OK);
+	if (!(access & USLOSS_MMU_REF)) return FALSE;
+	rc = USLOSS_MmuSetAccess(frame, access & ~USLOSS_MMU_REF);
+	assert(rc == USLOSS_MMU_OK);
+	P3_policy->referenced(frame);
+	return TRUE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AgingDaemon --
+ *
+ *  Keeps the aging policy's reference history. Every P3_agingInterval seconds it shifts the
+ *  history of each frame in use and samples (and clears) the frame's reference bit into the
+ *  top of it.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+AgingDaemon(void *arg)
+{
+	while (P3TickerWait(agingTicker)) {
+		P(policyLock);
+		for (int frame = 0; frame < numFrames; frame++) {
+			if (P3_frames[frame].state != P3_FRAME_INUSE) continue;
+			age[frame] >>= 1;
+			(void) TestRef(frame);
+		}
+		// the histories have changed
+		agingCount = 0;
+		agingNext = 0;
+		V(policyLock);
+	}
+	V(agingDone);
+	return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Now --
+ *
+ *  Returns the current time from the USLOSS clock.
+ *
+ * Results:
+ *   The time in microseconds.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+Now(void)
+{
+	int now;
+	int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+	assert(rc == USLOSS_DEV_OK);
+	return now;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ListInit, ListFree, ListRemove, ListAppend --
+ *
+ *  The frame list shared by FIFO and LRU. ListRemove ignores frames that aren't listed.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ListInit(void)
+{
+	listNext = (int *) malloc(numFrames*sizeof(int));
+	listPrev = (int *) malloc(numFrames*sizeof(int));
+	listed = (int *) calloc(numFrames, sizeof(int));
+	listHead = -1;
+	listTail = -1;
+}
+
+static void
+ListFree(void)
+{
+	free(listNext);
+	free(listPrev);
+	free(listed);
+}
+
+static void
+ListRemove(int frame)
+{
+	if (!listed[frame]) return;
+	if (listPrev[frame] == -1) listHead = listNext[frame];
+	else listNext[listPrev[frame]] = listNext[frame];
+	if (listNext[frame] == -1) listTail = listPrev[frame];
+	else listPrev[listNext[frame]] = listPrev[frame];
+	listed[frame] = FALSE;
+}
+
+static void
+ListAppend(int frame)
+{
+	assert(!listed[frame]);
+	listPrev[frame] = listTail;
+	listNext[frame] = -1;
+	if (listTail == -1) listHead = frame;
+	else listNext[listTail] = frame;
+	listTail = frame;
+	listed[frame] = TRUE;
+}
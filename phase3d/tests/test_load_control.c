@@ -0,0 +1,134 @@
+/*
+ * test_load_control.c
+ *
+ *  Tests that processes get through an overcommitted memory correctly while load control
+ *  suspends and resumes them. Four children, two of them at a lower priority, each write
+ *  a different value into every one of their pages and read it back, over and over, without
+ *  sleeping. All their pages together need four times the frames there are, so the system
+ *  thrashes and load control, turned on and set up to react quickly, suspends the
+ *  low-priority children. The children keep going until load control has resumed a process
+ *  (or they give up), and every child must still read back what it wrote and finish. Load
+ *  control must have suspended a process, paged it out, and resumed it.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 8         // # of pages per process
+#define FRAMES PAGES
+#define ITERATIONS 10       // # of iterations each child does at least
+#define MAX_ITERATIONS 1000 // # of iterations after which a child stops waiting for a resume
+#define PAGERS 2        // # of pagers
+
+static char *vmRegion;
+static char *names[] = {"A","B","C","D"};
+static int  priorities[] = {3, 3, 4, 4};
+static int  numChildren = sizeof(names) / sizeof(char *);
+static int  pageSize;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+static int debugging = 1;
+#else
+static int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static int
+Child(void *arg)
+{
+    char    *name = (char *) arg;
+    char    *page;
+    int     pid;
+
+    Sys_GetPID(&pid);
+    Debug("Child \"%s\" (%d) starting.\n", name, pid);
+
+    for (int i = 0; i < ITERATIONS || (P3_loadStats.resumes == 0 && i < MAX_ITERATIONS); i++) {
+        for (int j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            for (int k = 0; k < pageSize; k++) {
+                page[k] = *name + i + j;
+            }
+        }
+        for (int j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            for (int k = 0; k < pageSize; k++) {
+                TEST(page[k], (char) (*name + i + j));
+            }
+        }
+    }
+    Debug("Child \"%s\" (%d) done.\n", name, pid);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     i;
+    int     rc;
+    int     pid;
+    int     status;
+
+    Debug("P4_Startup starting.\n");
+    P3_loadControl = TRUE;
+    P3_thrashTurnover = 50;
+    P3_thrashQueue = 1;
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion);
+    TEST(rc, P1_SUCCESS);
+
+    pageSize = USLOSS_MmuPageSize();
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Spawn(names[i], Child, (void *) names[i], USLOSS_MIN_STACK * 4, priorities[i],
+                       &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    Debug("Children terminated: %d suspends, %d resumes, %d pages out\n",
+          P3_loadStats.suspends, P3_loadStats.resumes, P3_loadStats.pagedOut);
+    TEST(P3_loadStats.suspends > 0, TRUE);
+    TEST(P3_loadStats.pagedOut > 0, TRUE);
+    TEST(P3_loadStats.resumes > 0, TRUE);
+    Sys_VmShutdown();
+    PASSED();
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, numChildren * PAGES);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
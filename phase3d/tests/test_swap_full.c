@@ -0,0 +1,122 @@
+/*
+ * test_swap_full.c
+ *
+ *  Tests that swap doesn't run out when it only has room for the pages that don't fit in
+ *  memory. A child writes a different value into each of its pages, then reads them back
+ *  several times. Pages read back in keep their slots, so the read passes fill swap and the
+ *  slots of pages that are in memory have to be given up for the pages being evicted.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 40        // # of pages per process (must hold the swap disk and the frames)
+#define FRAMES 4
+#define TRACKS 4        // # of tracks on the swap disk
+#define PASSES 3        // # of read passes
+#define PAGERS 2        // # of pagers
+
+static char *vmRegion;
+static int  pageSize;
+static int  numPages;   // # of pages the child uses
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+static int debugging = 1;
+#else
+static int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static int
+Child(void *arg)
+{
+    int     i,j;
+    char    *page;
+    int     pid;
+
+    Sys_GetPID(&pid);
+    Debug("Child (%d) starting.\n", pid);
+
+    for (j = 0; j < numPages; j++) {
+        page = vmRegion + j * pageSize;
+        Debug("Child (%d) writing to page %d @ %p\n", pid, j, page);
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = 'A' + j;
+        }
+    }
+    for (i = 0; i < PASSES; i++) {
+        for (j = 0; j < numPages; j++) {
+            page = vmRegion + j * pageSize;
+            Debug("Child (%d) reading from page %d @ %p\n", pid, j, page);
+            for (int k = 0; k < pageSize; k++) {
+                TEST(page[k], 'A' + j);
+            }
+        }
+        Debug("Child (%d) pass %d: %d free blocks\n", pid, i, P3_vmStats.freeBlocks);
+    }
+    Debug("Child (%d) done.\n", pid);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    Debug("P4_Startup starting.\n");
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion);
+    TEST(rc, P1_SUCCESS);
+
+    pageSize = USLOSS_MmuPageSize();
+    // swap holds the pages that don't fit in memory, plus the one evicted to make room for
+    // the faulting page
+    numPages = P3_vmStats.blocks + FRAMES - 1;
+    TEST(numPages <= PAGES, TRUE);
+    rc = Sys_Spawn("Child", Child, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+    Debug("Child terminated\n");
+    Sys_VmShutdown();
+    PASSED();
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
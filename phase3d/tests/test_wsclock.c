@@ -0,0 +1,118 @@
+/*
+ * test_wsclock.c
+ *
+ *  Tests that WSClock finds a victim when every frame has been referenced since its last
+ *  sweep. A child writes a different value into each of its pages, which don't all fit in
+ *  memory, then slides a window as large as memory across them, touching each window twice.
+ *  The second pass references every frame, so the fault that moves the window on finds
+ *  them all referenced.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 8         // # of pages per process
+#define FRAMES ((PAGES) / 2)
+#define STEPS (2*(PAGES))   // # of times the window moves
+#define PAGERS 2        // # of pagers
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+static int debugging = 1;
+#else
+static int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static int
+Child(void *arg)
+{
+    int     i,j;
+    char    *page;
+    int     pid;
+
+    Sys_GetPID(&pid);
+    Debug("Child (%d) starting.\n", pid);
+
+    for (j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        Debug("Child (%d) writing to page %d @ %p\n", pid, j, page);
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = 'A' + j;
+        }
+    }
+    for (i = 0; i < STEPS; i++) {
+        for (int pass = 0; pass < 2; pass++) {
+            for (j = i; j < i + FRAMES; j++) {
+                page = vmRegion + (j % PAGES) * pageSize;
+                Debug("Child (%d) reading from page %d @ %p\n", pid, j % PAGES, page);
+                TEST(page[0], 'A' + j % PAGES);
+                TEST(page[pageSize - 1], 'A' + j % PAGES);
+            }
+        }
+    }
+    Debug("Child (%d) done.\n", pid);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    Debug("P4_Startup starting.\n");
+    P3_replacementPolicy = P3_POLICY_WSCLOCK;
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion);
+    TEST(rc, P1_SUCCESS);
+
+    pageSize = USLOSS_MmuPageSize();
+    rc = Sys_Spawn("Child", Child, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+    Debug("Child terminated\n");
+    Sys_VmShutdown();
+    PASSED();
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, PAGES);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
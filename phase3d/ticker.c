@@ -0,0 +1,158 @@
+/*
+ * ticker.c
+ *
+ *  Periodic wakeups for the phase3d daemons. A daemon that sleeps with Sys_Sleep can't be told
+ *  to quit until the sleep is over, so shutting it down would take up to a whole interval.
+ *  Instead a ticker process does the sleeping and V's the daemon's wake semaphore after each
+ *  interval, and P3TickerStop V's it right away.
+ *
+ *  The ticker may be asleep when its daemon quits, and the daemon may not have run yet when
+ *  the ticker notices it has been stopped, so both hold a reference to it and whichever lets
+ *  go last frees it.
+ */
+
+#include <assert.h>
+#include <phase1.h>
+#include <usloss.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <libuser.h>
+
+#include "phase3.h"
+#include "phase3Int.h"
+
+struct P3Ticker {
+	int     *interval;      // seconds between wakeups
+	int     stopped;
+	SID     wake;
+	SID     lock;           // protects refs
+	int     refs;           // the ticker process and the daemon
+};
+
+// numbers the semaphores; an old ticker's may still exist when a new one starts
+static int tickers = 0;
+
+static int  Ticker(void *arg);
+static void Release(P3Ticker *ticker);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3TickerStart --
+ *
+ *  Forks a ticker process that wakes up the caller's daemon every *interval seconds. The
+ *  interval is read before each sleep, so changes take effect at the next wakeup.
+ *
+ * Results:
+ *   The ticker.
+ *
+ *----------------------------------------------------------------------
+ */
+P3Ticker *
+P3TickerStart(char *name, int *interval, int priority)
+{
+	P3Ticker *ticker = (P3Ticker *) malloc(sizeof(P3Ticker));
+	assert(ticker != NULL);
+	ticker->interval = interval;
+	ticker->stopped = FALSE;
+	ticker->refs = 2;
+	char semName[P1_MAXNAME+1];
+	snprintf(semName, sizeof(semName), "%sLock%d", name, tickers);
+	int rc = P1_SemCreate(semName, 1, &ticker->lock);
+	assert(rc == P1_SUCCESS);
+	snprintf(semName, sizeof(semName), "%sTick%d", name, tickers++);
+	rc = P1_SemCreate(semName, 0, &ticker->wake);
+	assert(rc == P1_SUCCESS);
+	int pid;
+	rc = P1_Fork(semName, Ticker, (void *) ticker, USLOSS_MIN_STACK, priority, 0, &pid);
+	assert(rc == P1_SUCCESS);
+	return ticker;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3TickerWait --
+ *
+ *  Waits for the next wakeup. Only the daemon the ticker belongs to may call it.
+ *
+ * Results:
+ *   TRUE at the end of an interval, FALSE once the ticker has been stopped. The ticker must
+ *   not be used after FALSE is returned.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3TickerWait(P3Ticker *ticker)
+{
+	int rc = P1_P(ticker->wake);
+	assert(rc == P1_SUCCESS);
+	if (!ticker->stopped) return TRUE;
+	Release(ticker);
+	return FALSE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3TickerStop --
+ *
+ *  Stops the ticker and wakes up its daemon, whose P3TickerWait returns FALSE.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3TickerStop(P3Ticker *ticker)
+{
+	ticker->stopped = TRUE;
+	int rc = P1_V(ticker->wake);
+	assert(rc == P1_SUCCESS);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Ticker --
+ *
+ *  The ticker process.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+Ticker(void *arg)
+{
+	P3Ticker *ticker = (P3Ticker *) arg;
+	while (1) {
+		int rc = Sys_Sleep(*ticker->interval > 0 ? *ticker->interval : 1);
+		assert(rc == P1_SUCCESS);
+		if (ticker->stopped) break;
+		rc = P1_V(ticker->wake);
+		assert(rc == P1_SUCCESS);
+	}
+	Release(ticker);
+	return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Release --
+ *
+ *  Drops a reference to the ticker, freeing it if it was the last one.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+Release(P3Ticker *ticker)
+{
+	int rc = P1_P(ticker->lock);
+	assert(rc == P1_SUCCESS);
+	int last = (--ticker->refs == 0);
+	rc = P1_V(ticker->lock);
+	assert(rc == P1_SUCCESS);
+	if (last) {
+		assert(P1_SemFree(ticker->wake) == P1_SUCCESS);
+		assert(P1_SemFree(ticker->lock) == P1_SUCCESS);
+		free(ticker);
+	}
+}